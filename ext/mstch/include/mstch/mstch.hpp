@@ -110,4 +110,21 @@ std::string render(
     const std::map<std::string,std::string>& partials =
         std::map<std::string,std::string>());
 
+class compiled_template {
+ public:
+  compiled_template() = default;
+  explicit compiled_template(
+      const std::string& tmplt,
+      const std::map<std::string,std::string>& partials =
+          std::map<std::string,std::string>());
+  std::string render(const node& root) const;
+  bool empty() const { return !m_impl; }
+
+ private:
+  struct impl;
+  std::shared_ptr<const impl> m_impl;
+};
+
+std::string render(const compiled_template& tmplt, const node& root);
+
 }
@@ -18,3 +18,29 @@ std::string mstch::render(
 
   return render_context(root, partial_templates).render(tmplt);
 }
+
+struct mstch::compiled_template::impl {
+  template_type tmplt;
+  std::map<std::string, template_type> partials;
+};
+
+mstch::compiled_template::compiled_template(
+    const std::string& tmplt,
+    const std::map<std::string,std::string>& partials)
+{
+  auto compiled = std::make_shared<impl>();
+  compiled->tmplt = template_type(tmplt);
+  for (auto& partial: partials)
+    compiled->partials.insert({partial.first, {partial.second}});
+  m_impl = compiled;
+}
+
+std::string mstch::compiled_template::render(const node& root) const {
+  if (!m_impl)
+    return "";
+  return render_context(root, m_impl->partials).render(m_impl->tmplt);
+}
+
+std::string mstch::render(const compiled_template& tmplt, const node& root) {
+  return tmplt.render(root);
+}
@@ -4,6 +4,7 @@
 #include "src/CmdLineOptions.h"
 #include "src/MicroCore.h"
 #include "src/page.h"
+#include "src/ChainIndexer.h"
 
 
 #include <boost/uuid/uuid.hpp>            // uuid class
@@ -39,10 +40,23 @@ int main(int ac, const char* av[]) {
     auto bc_path_opt        = opts.get_option<string>("bc-path");
     auto custom_db_path_opt = opts.get_option<string>("custom-db-path");
     auto deamon_url_opt     = opts.get_option<string>("deamon-url");
+    auto reload_tmpl_opt    = opts.get_option<bool>("reload-templates");
+    auto threads_opt        = opts.get_option<size_t>("threads");
+    auto cache_size_opt     = opts.get_option<size_t>("cache-size");
+    auto index_chain_opt    = opts.get_option<bool>("index-chain");
+    auto cache_stats_opt    = opts.get_option<bool>("enable-cache-stats");
 
     //cast port number in string to uint16
     uint16_t app_port = boost::lexical_cast<uint16_t>(*port_opt);
 
+    // number of threads handling http requests
+    size_t no_of_threads = *threads_opt;
+
+    if (no_of_threads == 0)
+    {
+        no_of_threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+    }
+
     // get blockchain path
     path blockchain_path;
 
@@ -68,6 +82,13 @@ int main(int ac, const char* av[]) {
         return EXIT_FAILURE;
     }
 
+    // keep track of the current blockchain height
+    // in the background
+    mcore.start_tip_tracker();
+
+    // memory for caching decoded blocks and txs, given in MB
+    mcore.set_cache_size(*cache_size_opt * 1024 * 1024);
+
     // check if we have path to lmdb2 (i.e., custom db)
     // and if it exists
 
@@ -96,11 +117,59 @@ int main(int ac, const char* av[]) {
 
     custom_db_path_str = xmreg::remove_trailing_path_separator(custom_db_path_str);
 
+    // open the custom lmdb database once, and share it
+    // between the page and all searches
+    shared_ptr<xmreg::MyLMDB> mylmdb;
+
+    if (boost::filesystem::is_directory(custom_db_path_str))
+    {
+        cout << "Custom lmdb database seem to exist at: "
+             << custom_db_path_str << endl;
+
+        mylmdb = make_shared<xmreg::MyLMDB>(custom_db_path_str);
+
+        // searches read outputs by height. Older lmdb2 databases
+        // dont have them, so such blocks are read by timestamp
+        uint64_t last_output_height;
+
+        if (!mylmdb->get_last_output_info_height(last_output_height))
+        {
+            cerr << "No outputs by height in the custom lmdb database. "
+                 << "Searching for outputs will use outputs by timestamp, "
+                 << "which is slower. Rebuild the database to fix it." << endl;
+        }
+        else if (last_output_height + 1 < mcore.get_current_blockchain_height())
+        {
+            cerr << "Outputs by height in the custom lmdb database end at block "
+                 << last_output_height << ". Searching for outputs above it "
+                 << "will use outputs by timestamp, which is slower." << endl;
+        }
+    }
+    else
+    {
+        cerr << "Custom lmdb database not found at: " << custom_db_path_str
+             << ". Searching for outputs will not be possible." << endl;
+    }
+
+    // write new blocks to the custom lmdb database as they
+    // arrive, instead of relying on a separate tool
+    unique_ptr<xmreg::ChainIndexer> indexer;
+
+    if (*index_chain_opt && mylmdb)
+    {
+        indexer.reset(new xmreg::ChainIndexer(&mcore, mylmdb));
+        indexer->start();
+    }
 
     // create instance of page class which
     // contains logic for the website
     xmreg::page xmrblocks(&mcore, core_storage,
-                          *deamon_url_opt, custom_db_path_str);
+                          *deamon_url_opt, mylmdb);
+
+    if (*reload_tmpl_opt)
+    {
+        xmrblocks.reload_templates_on_change();
+    }
 
     // crow instance
     crow::SimpleApp app;
@@ -110,6 +179,39 @@ int main(int ac, const char* av[]) {
         return xmrblocks.index2();
     });
 
+    // sizes and hit rates of the blocks and txs caches. Not
+    // shown by default, as they are of no use to the users.
+    if (*cache_stats_opt)
+    {
+        CROW_ROUTE(app, "/cachestats")
+        ([&]() {
+            return mcore.get_cache_stats();
+        });
+    }
+
+    CROW_ROUTE(app, "/search").methods("GET"_method)
+    ([&](const crow::request& req) {
+
+        string search_text = string(req.url_params.get("value"));
+
+        // page of prefix search results, if given
+        uint64_t page_no {0};
+
+        if (req.url_params.get("page") != nullptr)
+        {
+            try
+            {
+                page_no = boost::lexical_cast<uint64_t>(req.url_params.get("page"));
+            }
+            catch (boost::bad_lexical_cast& e)
+            {
+                cerr << "Cant parse page number: " << req.url_params.get("page") << endl;
+            }
+        }
+
+        return xmrblocks.search(search_text, page_no);
+    });
+
     CROW_ROUTE(app, "/finish_search").methods("GET"_method)
     ([&](const crow::request& req) {
         string uuid  = string(req.url_params.get("uuid"));
@@ -178,13 +280,12 @@ int main(int ac, const char* av[]) {
 
 
         // get the current blockchain height.
-        uint64_t height =
-                xmreg::MyLMDB::get_blockchain_height(
-                        mcore.get_blkchain_path()) - 1;
+        uint64_t height = mcore.get_current_blockchain_height() - 1;
 
         shared_ptr<xmreg::search_class_test> search_cls
                 = shared_ptr<xmreg::search_class_test>(
                         new xmreg::search_class_test(&mcore, core_storage,
+                                                     mylmdb,
                                                      xmr_address, viewkey,
                                                      since_when, height)
                 );
@@ -195,7 +296,9 @@ int main(int ac, const char* av[]) {
     });
 
     // run the crow http server
-    app.port(app_port).run();
+    app.port(app_port)
+       .concurrency(static_cast<uint16_t>(no_of_threads))
+       .run();
 
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,200 @@
+// Measures speed of scanning outputs for a given address and viewkey,
+// as done for /myoutputs: with key derivation for every output (as
+// it was done before) and with one derivation per tx (as it is done
+// now by search_class_test::check_block_outputs).
+//
+// Outputs are read from the custom lmdb before timing, so only
+// the key derivations and comparisons are measured.
+//
+
+#include "src/page.h"
+
+#include <boost/program_options.hpp>
+
+using namespace std;
+using namespace boost::program_options;
+
+// needed for log system of momero
+namespace epee {
+    unsigned int g_test_dbg_lock_sleep = 0;
+}
+
+struct scanned_block
+{
+    uint64_t blk_height;
+    uint64_t blk_timestamp;
+    vector<xmreg::output_info> outputs_info;
+};
+
+/**
+ * Scan using derivation for each output,
+ * i.e., without per tx caching.
+ */
+uint64_t
+scan_per_output(const vector<scanned_block>& blocks,
+                const cryptonote::account_public_address& address,
+                const crypto::secret_key& prv_view_key,
+                uint64_t& no_of_derivations)
+{
+    uint64_t no_of_found {0};
+
+    for (const scanned_block& blk: blocks)
+    {
+        for (const xmreg::output_info& out_info: blk.outputs_info)
+        {
+            crypto::key_derivation derivation;
+
+            ++no_of_derivations;
+
+            if (!generate_key_derivation(out_info.tx_pub_key,
+                                         prv_view_key, derivation))
+            {
+                continue;
+            }
+
+            crypto::public_key generated_pubkey;
+
+            derive_public_key(derivation, out_info.index_in_tx,
+                              address.m_spend_public_key,
+                              generated_pubkey);
+
+            if (out_info.out_pub_key == generated_pubkey)
+            {
+                ++no_of_found;
+            }
+        }
+    }
+
+    return no_of_found;
+}
+
+
+int main(int ac, const char* av[])
+{
+    options_description desc("xmrscanbench, measure speed of scanning for outputs");
+
+    desc.add_options()
+            ("help,h", "produce help message")
+            ("custom-db-path,c", value<string>()->required(),
+             "path to the custom lmdb database")
+            ("address,a", value<string>()->required(),
+             "monero address")
+            ("viewkey,v", value<string>()->required(),
+             "private viewkey of the address")
+            ("from", value<uint64_t>()->default_value(0),
+             "first block to scan")
+            ("to", value<uint64_t>()->default_value(10000),
+             "last block to scan");
+
+    variables_map vm;
+
+    try
+    {
+        store(parse_command_line(ac, av, desc), vm);
+
+        if (vm.count("help"))
+        {
+            cout << desc << endl;
+            return EXIT_SUCCESS;
+        }
+
+        notify(vm);
+    }
+    catch (const boost::program_options::error& e)
+    {
+        cerr << e.what() << "\n" << desc << endl;
+        return EXIT_FAILURE;
+    }
+
+    string address_str = vm["address"].as<string>();
+    string viewkey_str = vm["viewkey"].as<string>();
+
+    cryptonote::account_public_address address;
+    crypto::secret_key prv_view_key;
+
+    if (!xmreg::parse_str_address(address_str, address, 0))
+    {
+        cerr << "Cant parse string address: " << address_str << endl;
+        return EXIT_FAILURE;
+    }
+
+    if (!xmreg::parse_str_secret_key(viewkey_str, prv_view_key))
+    {
+        cerr << "Cant parse view key: " << viewkey_str << endl;
+        return EXIT_FAILURE;
+    }
+
+    auto mylmdb = make_shared<xmreg::MyLMDB>(vm["custom-db-path"].as<string>());
+
+    // read all outputs first, so that reading
+    // them is not included in the timings
+    vector<scanned_block> blocks;
+
+    uint64_t no_of_outputs {0};
+
+    mylmdb->get_output_info_range(
+            vm["from"].as<uint64_t>(), vm["to"].as<uint64_t>(),
+            [&](uint64_t blk_height, uint64_t blk_timestamp,
+                vector<xmreg::output_info>& outputs_info) -> bool
+            {
+                no_of_outputs += outputs_info.size();
+                blocks.push_back({blk_height, blk_timestamp, outputs_info});
+                return true;
+            });
+
+    if (blocks.empty())
+    {
+        cerr << "No outputs found in the given blocks" << endl;
+        return EXIT_FAILURE;
+    }
+
+    // before: derivation for each output
+    uint64_t no_of_derivations {0};
+
+    auto t0 = std::chrono::steady_clock::now();
+
+    uint64_t found_before = scan_per_output(blocks, address, prv_view_key,
+                                            no_of_derivations);
+
+    double seconds_before = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - t0).count();
+
+    // after: the scanner used by the explorer, with
+    // one derivation for each tx
+    xmreg::search_class_test search {nullptr, nullptr, mylmdb,
+                                     address_str, viewkey_str, 1, 0};
+
+    xmreg::search_class_test::chunk_result result;
+
+    t0 = std::chrono::steady_clock::now();
+
+    for (const scanned_block& blk: blocks)
+    {
+        search.check_block_outputs(blk.blk_height, blk.blk_timestamp,
+                                   blk.outputs_info, result);
+    }
+
+    double seconds_after = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - t0).count();
+
+    cout << fmt::format("Scanned {:d} outputs in {:d} blocks\n",
+                        no_of_outputs, blocks.size());
+
+    cout << fmt::format("per output: {:0.3f} s, {:d} derivations, "
+                        "{:0.0f} derivations/s, {:0.0f} outputs/s, "
+                        "{:d} outputs found\n",
+                        seconds_before, no_of_derivations,
+                        no_of_derivations / seconds_before,
+                        no_of_outputs / seconds_before, found_before);
+
+    cout << fmt::format("per tx:     {:0.3f} s, {:d} derivations, "
+                        "{:0.0f} derivations/s, {:0.0f} outputs/s, "
+                        "{:d} outputs found\n",
+                        seconds_after, result.no_of_derivations,
+                        result.no_of_derivations / seconds_after,
+                        no_of_outputs / seconds_after, result.found.size());
+
+    cout << fmt::format("speedup: {:0.2f}x\n", seconds_before / seconds_after);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,347 @@
+#include "ChainIndexer.h"
+
+namespace xmreg
+{
+
+    ChainIndexer::ChainIndexer(MicroCore* _mcore, shared_ptr<MyLMDB> _mylmdb)
+        : mcore {_mcore}, mylmdb {_mylmdb}
+    {}
+
+
+    /**
+     * Start indexing new blocks in the background. The tip of
+     * the blockchain is checked every refresh_interval.
+     */
+    void
+    ChainIndexer::start(std::chrono::seconds refresh_interval)
+    {
+        if (m_thread.joinable())
+        {
+            return;
+        }
+
+        m_stop = false;
+
+        m_thread = std::thread([this, refresh_interval]()
+        {
+            while (!m_stop && !m_failed)
+            {
+                // dont wait if there are more blocks to index
+                if (!index_new_blocks())
+                {
+                    continue;
+                }
+
+                std::unique_lock<std::mutex> lck (m_mutex);
+
+                m_cv.wait_for(lck, refresh_interval,
+                              [this]() { return m_stop.load(); });
+            }
+        });
+    }
+
+
+    /**
+     * Index blocks from the last indexed one up to the tip,
+     * but no more than BLOCKS_PER_ROUND of them.
+     *
+     * Returns false if there are more blocks to index right away.
+     */
+    bool
+    ChainIndexer::index_new_blocks()
+    {
+        uint64_t chain_height = mcore->get_current_blockchain_height();
+
+        uint64_t next_height {0};
+
+        if (!roll_back_reorg(chain_height, next_height))
+        {
+            return true;
+        }
+
+        // far behind the tip, so index a whole batch at once
+        if (chain_height - next_height > BLOCKS_PER_BULK_TXN)
+        {
+            if (!index_blocks_in_bulk(next_height, BLOCKS_PER_BULK_TXN))
+            {
+                return true;
+            }
+
+            cout << "Indexed blocks up to "
+                 << next_height + BLOCKS_PER_BULK_TXN - 1 << endl;
+
+            return false;
+        }
+
+        // close to the tip, so the readers are not needed anymore
+        m_readers.reset();
+
+        uint64_t no_of_indexed {0};
+
+        while (next_height < chain_height
+               && no_of_indexed < BLOCKS_PER_ROUND
+               && !m_stop)
+        {
+            block blk;
+            vector<transaction> txs;
+
+            if (!read_block(next_height, blk, txs))
+            {
+                return true;
+            }
+
+            if (!mylmdb->index_block(blk, next_height, txs))
+            {
+                cerr << "Cant index block: " << next_height << endl;
+                return true;
+            }
+
+            ++next_height;
+            ++no_of_indexed;
+        }
+
+        if (no_of_indexed > 0)
+        {
+            cout << "Indexed " << no_of_indexed << " blocks up to "
+                 << next_height - 1 << endl;
+        }
+
+        return next_height >= chain_height;
+    }
+
+
+    /**
+     * Read and decode no_of_blocks blocks, starting from first_height,
+     * on the reader threads, and write them all in one write txn.
+     */
+    bool
+    ChainIndexer::index_blocks_in_bulk(uint64_t first_height, uint64_t no_of_blocks)
+    {
+        vector<vector<db_record>> blocks_records(no_of_blocks);
+        vector<crypto::hash>      blk_hashes(no_of_blocks);
+
+        std::atomic<uint64_t> next_block {0};
+        std::atomic<bool>     failed {false};
+
+        auto reader = [&]()
+        {
+            uint64_t i;
+
+            while (!failed && !m_stop && (i = next_block++) < no_of_blocks)
+            {
+                uint64_t blk_height = first_height + i;
+
+                block blk;
+                vector<transaction> txs;
+
+                if (!read_block(blk_height, blk, txs))
+                {
+                    failed = true;
+                    return;
+                }
+
+                blocks_records[i] = MyLMDB::get_block_records(blk, blk_height, txs);
+                blk_hashes[i]     = get_block_hash(blk);
+            }
+        };
+
+        if (!m_readers)
+        {
+            m_readers.reset(new thread_pool(
+                    std::max(1u, std::thread::hardware_concurrency())));
+        }
+
+        size_t no_of_tasks = std::min<uint64_t>(m_readers->size(), no_of_blocks);
+
+        vector<std::future<void>> readers;
+
+        for (size_t i = 0; i < no_of_tasks; ++i)
+        {
+            readers.push_back(m_readers->submit(reader));
+        }
+
+        for (std::future<void>& r: readers)
+        {
+            r.wait();
+        }
+
+        if (failed || m_stop)
+        {
+            return false;
+        }
+
+        if (!mylmdb->index_blocks_in_bulk(first_height, blocks_records, blk_hashes))
+        {
+            cerr << "Cant index blocks from: " << first_height << endl;
+            return false;
+        }
+
+        return true;
+    }
+
+
+    /**
+     * Remove indexed blocks that are no longer in the blockchain
+     * and find height of the next block to index.
+     *
+     * Only the last MyLMDB::MAX_UNDO_DEPTH blocks can be removed.
+     * A deeper reorg would leave records of blocks not in the
+     * blockchain, so then indexing stops, and the custom lmdb
+     * must be built again.
+     *
+     * Returns false if indexing cant go on now.
+     */
+    bool
+    ChainIndexer::roll_back_reorg(uint64_t chain_height, uint64_t& next_height)
+    {
+        bool has_indexed;
+
+        if (!mylmdb->get_indexed_height(next_height, has_indexed))
+        {
+            return false;
+        }
+
+        uint64_t     last_height;
+        crypto::hash last_hash;
+        bool         has_undo;
+
+        if (!has_indexed)
+        {
+            // indexed height was not kept by earlier versions,
+            // but they kept records of the last indexed blocks
+            if (!mylmdb->get_last_indexed_block(last_height, last_hash, has_undo))
+            {
+                return false;
+            }
+
+            if (!has_undo)
+            {
+                cout << "No blocks indexed yet in the custom lmdb database. "
+                     << "Indexing from the first block." << endl;
+
+                next_height = 0;
+
+                return true;
+            }
+
+            next_height = last_height + 1;
+        }
+
+        while (next_height > 0)
+        {
+            if (!mylmdb->get_last_indexed_block(last_height, last_hash, has_undo))
+            {
+                return false;
+            }
+
+            if (!has_undo || last_height + 1 != next_height)
+            {
+                cerr << "Block " << next_height - 1 << " is no longer in the "
+                     << "blockchain, but its records are not kept, so it cant be "
+                     << "removed from the custom lmdb database. Build the "
+                     << "database again. Indexing stopped." << endl;
+
+                m_failed = true;
+
+                return false;
+            }
+
+            if (last_height < chain_height
+                && mcore->get_core().get_block_id_by_height(last_height) == last_hash)
+            {
+                return true;
+            }
+
+            cout << "Block " << last_height << " is no longer in the blockchain. "
+                 << "Removing it from the custom lmdb database." << endl;
+
+            if (!mylmdb->unindex_last_block())
+            {
+                return false;
+            }
+
+            --next_height;
+        }
+
+        return true;
+    }
+
+
+    /**
+     * Read block and its txs, without the coinbase tx, straight
+     * from the blockchain database, i.e., not through the
+     * MicroCore cache. Can be called by many threads at once.
+     */
+    bool
+    ChainIndexer::read_block(uint64_t blk_height, block& blk, vector<transaction>& txs)
+    {
+        try
+        {
+            BlockchainDB& db = mcore->get_core().get_db();
+
+            if (!parse_and_validate_block_from_blob(
+                    db.get_block_blob_from_height(blk_height), blk))
+            {
+                cerr << "Cant parse block to index: " << blk_height << endl;
+                return false;
+            }
+
+            txs.reserve(blk.tx_hashes.size());
+
+            for (const crypto::hash& tx_hash: blk.tx_hashes)
+            {
+                blobdata tx_blob;
+
+                if (!db.get_tx_blob(tx_hash, tx_blob))
+                {
+                    cerr << "Cant get tx of block to index: " << blk_height << endl;
+                    return false;
+                }
+
+                transaction tx;
+
+                if (!parse_and_validate_tx_from_blob(tx_blob, tx))
+                {
+                    cerr << "Cant parse tx of block to index: " << blk_height << endl;
+                    return false;
+                }
+
+                txs.push_back(std::move(tx));
+            }
+        }
+        catch (const std::exception& e)
+        {
+            cerr << "Cant get block to index: " << blk_height
+                 << ", " << e.what() << endl;
+            return false;
+        }
+
+        return true;
+    }
+
+
+    void
+    ChainIndexer::stop()
+    {
+        if (!m_thread.joinable())
+        {
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lck (m_mutex);
+            m_stop = true;
+        }
+
+        m_cv.notify_all();
+
+        m_thread.join();
+    }
+
+
+    ChainIndexer::~ChainIndexer()
+    {
+        stop();
+    }
+
+}
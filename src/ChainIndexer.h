@@ -0,0 +1,97 @@
+#ifndef XMREG01_CHAININDEXER_H
+#define XMREG01_CHAININDEXER_H
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include "monero_headers.h"
+#include "MicroCore.h"
+#include "tools.h"
+#include "mylmdb.h"
+#include "thread_pool.h"
+
+namespace xmreg
+{
+
+    using namespace std;
+
+    /**
+     * Keeps the custom lmdb database up to date with the blockchain.
+     *
+     * In a background thread, blocks not yet in the custom lmdb
+     * are read from the blockchain database and written to it, one
+     * write txn per block. Blocks are read bypassing the MicroCore
+     * cache, so that indexing does not evict blocks and txs
+     * cached for the pages. If the last indexed block is no longer
+     * in the blockchain, i.e., there was a reorg, indexed blocks are
+     * removed until the one still in the blockchain is found.
+     *
+     * A reorg deeper than the blocks whose records are kept for
+     * removing them stops the indexer, as the custom lmdb then
+     * needs to be built again.
+     *
+     * When far behind the tip, e.g., when building the custom
+     * lmdb from scratch, blocks are read by a pool of threads, kept
+     * until the indexer catches up, and written in large batches,
+     * one write txn per batch.
+     */
+    class ChainIndexer
+    {
+        MicroCore* mcore;
+
+        shared_ptr<MyLMDB> mylmdb;
+
+        std::thread             m_thread;
+        std::atomic<bool>       m_stop {false};
+
+        // set if the custom lmdb cant be kept up to date anymore
+        std::atomic<bool>       m_failed {false};
+
+        // threads reading blocks for bulk indexing. Made for the
+        // first batch, and removed when the tip is reached.
+        unique_ptr<thread_pool> m_readers;
+        std::mutex              m_mutex;
+        std::condition_variable m_cv;
+
+    public:
+
+        // max number of blocks indexed before checking the tip again
+        static const uint64_t BLOCKS_PER_ROUND {1000};
+
+        // number of blocks written in one write txn when
+        // more than that of them are to be indexed
+        static const uint64_t BLOCKS_PER_BULK_TXN {1000};
+
+        ChainIndexer(MicroCore* _mcore, shared_ptr<MyLMDB> _mylmdb);
+
+        void
+        start(std::chrono::seconds refresh_interval = std::chrono::seconds(5));
+
+        void
+        stop();
+
+        virtual ~ChainIndexer();
+
+    private:
+
+        bool
+        index_new_blocks();
+
+        bool
+        index_blocks_in_bulk(uint64_t first_height, uint64_t no_of_blocks);
+
+        bool
+        roll_back_reorg(uint64_t chain_height, uint64_t& next_height);
+
+        bool
+        read_block(uint64_t blk_height, block& blk, vector<transaction>& txs);
+    };
+
+}
+
+#endif //XMREG01_CHAININDEXER_H
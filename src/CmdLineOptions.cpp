@@ -30,7 +30,17 @@ namespace xmreg
                 ("custom-db-path,c", value<string>(),
                  "path to the custom lmdb database used for searching things")
                 ("deamon-url,d", value<string>()->default_value("http:://127.0.0.1:18081"),
-                 "monero address string");
+                 "monero address string")
+                ("threads,t", value<size_t>()->default_value(0),
+                 "number of threads handling http requests, 0 means number of cpu cores")
+                ("cache-size", value<size_t>()->default_value(64),
+                 "memory for cached blocks and transactions, in MB")
+                ("reload-templates", value<bool>()->default_value(false)->implicit_value(true),
+                 "reload html templates when they change (for development)")
+                ("index-chain", value<bool>()->default_value(false)->implicit_value(true),
+                 "keep the custom lmdb database up to date with the blockchain")
+                ("enable-cache-stats", value<bool>()->default_value(false)->implicit_value(true),
+                 "show sizes and hit rates of the blocks and txs caches at /cachestats");
 
 
         store(command_line_parser(acc, avv)
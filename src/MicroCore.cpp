@@ -4,6 +4,8 @@
 
 #include "MicroCore.h"
 
+#include "../ext/format.h"
+
 namespace xmreg
 {
     /**
@@ -69,7 +71,12 @@ namespace xmreg
 
         // initialize Blockchain object to manage
         // the database.
-        return m_blockchain_storage.init(db, false);
+        if (!m_blockchain_storage.init(db, false))
+        {
+            return false;
+        }
+
+        return refresh_current_blockchain_height();
     }
 
     /**
@@ -90,12 +97,16 @@ namespace xmreg
     bool
     MicroCore::get_block_by_height(const uint64_t& height, block& blk)
     {
+        if (m_blocks_cache.get(height, blk))
+        {
+            return true;
+        }
 
-        crypto::hash block_id;
+        blobdata blk_blob;
 
         try
         {
-            block_id = m_blockchain_storage.get_block_id_by_height(height);
+            blk_blob = m_blockchain_storage.get_db().get_block_blob_from_height(height);
         }
         catch (const exception& e)
         {
@@ -103,22 +114,25 @@ namespace xmreg
             return false;
         }
 
-
-        if (!m_blockchain_storage.get_block_by_hash(block_id, blk))
+        if (!parse_and_validate_block_from_blob(blk_blob, blk))
         {
-            cerr << "Block with hash " << block_id
-                 << "and height " << height << " not found!"
-                 << endl;
+            cerr << "Cant parse block of height " << height << endl;
             return false;
         }
 
+        if (is_cacheable(height))
+        {
+            m_blocks_cache.put(height, blk, blk_blob.size());
+        }
+
         return true;
     }
 
     /**
-     * Finds the first block created in a given day, e.g., 2015-05-22
-     *
+     * Finds the last block created before a given day, e.g., 2015-05-22
      *
+     * Uses the in-memory block timestamps, so init_height
+     * is only checked, not needed for the search.
      */
     bool
     MicroCore::get_block_by_date(const string& date, /* searched date */
@@ -128,7 +142,7 @@ namespace xmreg
     {
 
         // get the current blockchain height.
-        uint64_t max_height = m_blockchain_storage.get_current_blockchain_height();
+        uint64_t max_height = get_current_blockchain_height();
 
         if (init_height > max_height)
         {
@@ -148,76 +162,94 @@ namespace xmreg
         // change the requested date ptime into timestamp
         uint64_t searched_timestamp = static_cast<uint64_t>(xmreg::to_time_t(parser.pt));
 
-        //cout << "searched_timestamp: " << searched_timestamp << endl;
+        // first block with timestamp not earlier than the searched one
+        uint64_t height;
 
-        // get block at initial guest height
-        block tmp_blk;
+        if (!get_height_by_timestamp(searched_timestamp, height))
+        {
+            return false;
+        }
 
-        if (!get_block_by_height(init_height, tmp_blk))
+        // take one before this one
+        if (height > 0)
         {
-            cerr << "Cant find block of height " << init_height << endl;
+            --height;
+        }
+
+        if (!get_block_by_height(height, blk))
+        {
+            cerr << "Cant find block of height " << height << endl;
             return false;
         }
 
-        // assume the initall block is correct
-        blk = tmp_blk;
+        return true;
+    }
 
-        // get timestamp of the initial block
-        //cout << tmp_blk.timestamp  << ", " << searched_timestamp << endl;
 
-        // if init block and time do not match, do iterative search for the correct block
+    /**
+     * Height of the first block with timestamp not earlier
+     * than the given one. If there is no such block, the
+     * current blockchain height is returned.
+     *
+     * Its binary search in the in-memory block timestamps.
+     */
+    bool
+    MicroCore::get_height_by_timestamp(uint64_t timestamp, uint64_t& height)
+    {
+        std::lock_guard<std::mutex> lck (m_blk_timestamps_mutex);
 
-        // if found init block was earlier than the search time, iterate increasing block heigths
-        if (tmp_blk.timestamp < searched_timestamp)
+        if (m_blk_timestamps.empty())
         {
-            for (uint64_t i = init_height + 1; i < max_height; ++i)
-            {
-                block tmp_blk2;
-                if (!get_block_by_height(i, tmp_blk2))
-                {
-                    cerr << "Cant find block of height " << i << endl;
-                    return false;
-                }
+            cerr << "Block timestamps not available" << endl;
+            return false;
+        }
 
-                //cout << tmp_blk2.timestamp - searched_timestamp << endl;
+        height = std::lower_bound(m_blk_timestamps.begin(),
+                                  m_blk_timestamps.end(),
+                                  timestamp) - m_blk_timestamps.begin();
 
-                if (tmp_blk2.timestamp >= searched_timestamp)
-                {
+        return true;
+    }
 
-                    // take one before this one:
 
-                    if (!get_block_by_height(--i, tmp_blk2))
-                    {
-                        cerr << "Cant find block of height " << i << endl;
-                        return false;
-                    }
+    /**
+     * Add timestamps of new blocks to m_blk_timestamps, so that it
+     * has height of them. Timestamps of the last CACHE_REORG_DEPTH
+     * blocks are read again, in case they were reorganized.
+     */
+    bool
+    MicroCore::update_blk_timestamps(uint64_t height)
+    {
+        std::lock_guard<std::mutex> lck (m_blk_timestamps_mutex);
 
-                    blk = tmp_blk2;
-                    break;
-                }
+        uint64_t reread_from = m_blk_timestamps.size() > CACHE_REORG_DEPTH
+                               ? m_blk_timestamps.size() - CACHE_REORG_DEPTH
+                               : 0;
 
-            }
-        }
-        else
+        m_blk_timestamps.resize(std::min(reread_from, height));
+
+        m_blk_timestamps.reserve(height);
+
+        try
         {
-            for (uint64_t i = init_height - 1; i >= 0; --i)
+            for (uint64_t i = m_blk_timestamps.size(); i < height; ++i)
             {
-                block tmp_blk2;
-                if (!get_block_by_height(i, tmp_blk2))
-                {
-                    cerr << "Cant find block of height " << i << endl;
-                    return false;
-                }
-
-                //cout << tmp_blk2.timestamp - searched_timestamp << endl;
+                uint64_t blk_timestamp = m_blockchain_storage.get_db()
+                        .get_block_timestamp(i);
 
-                if (tmp_blk2.timestamp <= searched_timestamp)
+                if (!m_blk_timestamps.empty())
                 {
-                    blk = tmp_blk2;
-                    break;
+                    blk_timestamp = std::max(blk_timestamp, m_blk_timestamps.back());
                 }
+
+                m_blk_timestamps.push_back(blk_timestamp);
             }
         }
+        catch (const std::exception& e)
+        {
+            cerr << "Cant get block timestamps: " << e.what() << endl;
+            return false;
+        }
 
         return true;
     }
@@ -230,10 +262,25 @@ namespace xmreg
     bool
     MicroCore::get_tx(const crypto::hash& tx_hash, transaction& tx)
     {
+        if (m_txs_cache.get(tx_hash, tx))
+        {
+            return true;
+        }
+
+        blobdata tx_blob;
+
+        uint64_t tx_blk_height;
+
         try
         {
             // get transaction with given hash
-            tx = m_blockchain_storage.get_db().get_tx(tx_hash);
+            if (!m_blockchain_storage.get_db().get_tx_blob(tx_hash, tx_blob))
+            {
+                cerr << "Tx not found: " << tx_hash << endl;
+                return false;
+            }
+
+            tx_blk_height = m_blockchain_storage.get_db().get_tx_block_height(tx_hash);
         }
         catch (const exception& e)
         {
@@ -241,6 +288,17 @@ namespace xmreg
             return false;
         }
 
+        if (!parse_and_validate_tx_from_blob(tx_blob, tx))
+        {
+            cerr << "Cant parse tx: " << tx_hash << endl;
+            return false;
+        }
+
+        if (is_cacheable(tx_blk_height))
+        {
+            m_txs_cache.put(tx_hash, tx, tx_blob.size());
+        }
+
         return true;
     }
 
@@ -268,6 +326,131 @@ namespace xmreg
     }
 
 
+    /**
+     * Get many transactions from the blockchain in one go.
+     *
+     * Found txs are in the same order as their hashes
+     * in tx_hashes. Hashes of txs not found are put into missed_txs.
+     *
+     * Txs in the cache are taken from it. The rest are read at once
+     * using Blockchain::get_transactions. If all the txs are from a
+     * block of known height, it can be given as blk_height, so that
+     * heights of the txs read dont need to be checked before
+     * caching them.
+     */
+    bool
+    MicroCore::get_txs(const vector<crypto::hash>& tx_hashes,
+                       vector<transaction>& txs,
+                       vector<crypto::hash>& missed_txs,
+                       uint64_t blk_height)
+    {
+        vector<transaction> found_txs(tx_hashes.size());
+        vector<bool> is_found(tx_hashes.size(), false);
+
+        // txs not in the cache, with their positions in tx_hashes
+        vector<crypto::hash> not_cached;
+        vector<size_t>       not_cached_idx;
+
+        for (size_t i = 0; i < tx_hashes.size(); ++i)
+        {
+            if (m_txs_cache.get(tx_hashes[i], found_txs[i]))
+            {
+                is_found[i] = true;
+                continue;
+            }
+
+            not_cached.push_back(tx_hashes[i]);
+            not_cached_idx.push_back(i);
+        }
+
+        if (!not_cached.empty())
+        {
+            vector<transaction> read_txs;
+            vector<crypto::hash> read_missed;
+
+            try
+            {
+                m_blockchain_storage.get_transactions(not_cached, read_txs, read_missed);
+            }
+            catch (const exception& e)
+            {
+                cerr << e.what() << endl;
+                return false;
+            }
+
+            // read txs and missed hashes are both in the order of not_cached
+            auto read_tx          = read_txs.begin();
+            auto read_missed_hash = read_missed.begin();
+
+            for (size_t i = 0; i < not_cached.size(); ++i)
+            {
+                if (read_missed_hash != read_missed.end()
+                    && *read_missed_hash == not_cached[i])
+                {
+                    ++read_missed_hash;
+                    continue;
+                }
+
+                if (read_tx == read_txs.end())
+                {
+                    break;
+                }
+
+                size_t idx = not_cached_idx[i];
+
+                found_txs[idx] = std::move(*read_tx++);
+                is_found[idx]  = true;
+
+                cache_tx(not_cached[i], found_txs[idx], blk_height);
+            }
+        }
+
+        txs.reserve(txs.size() + tx_hashes.size());
+
+        for (size_t i = 0; i < tx_hashes.size(); ++i)
+        {
+            if (!is_found[i])
+            {
+                missed_txs.push_back(tx_hashes[i]);
+                continue;
+            }
+
+            txs.push_back(std::move(found_txs[i]));
+        }
+
+        return true;
+    }
+
+
+    /**
+     * Put tx read from the blockchain into the txs cache, if its
+     * block is deep enough. If height of the block is not given,
+     * it is read from the blockchain.
+     */
+    void
+    MicroCore::cache_tx(const crypto::hash& tx_hash,
+                        const transaction& tx,
+                        uint64_t blk_height)
+    {
+        if (blk_height == std::numeric_limits<uint64_t>::max())
+        {
+            try
+            {
+                blk_height = m_blockchain_storage.get_db().get_tx_block_height(tx_hash);
+            }
+            catch (const exception&)
+            {
+                return;
+            }
+        }
+
+        if (is_cacheable(blk_height))
+        {
+            m_txs_cache.put(tx_hash, tx, get_object_blobsize(tx));
+        }
+    }
+
+
 
 
     /**
@@ -407,6 +590,8 @@ namespace xmreg
      */
     MicroCore::~MicroCore()
     {
+        stop_tip_tracker();
+
         delete &m_blockchain_storage.get_db();
     }
 
@@ -437,4 +622,134 @@ namespace xmreg
         return blockchain_path;
     }
 
+
+    /**
+     * Number of blocks in the blockchain as seen by the
+     * last refresh of the chain tip tracker
+     */
+    uint64_t
+    MicroCore::get_current_blockchain_height() const
+    {
+        return m_current_height.load(std::memory_order_relaxed);
+    }
+
+
+    /**
+     * Read number of blocks from the already opened
+     * blockchain database
+     */
+    bool
+    MicroCore::refresh_current_blockchain_height()
+    {
+        try
+        {
+            uint64_t height = m_blockchain_storage.get_db().height();
+
+            if (height < m_current_height)
+            {
+                // reorganization deeper than we thought possible,
+                // so cached blocks and txs can be out of date
+                cerr << "Blockchain height decreased from " << m_current_height
+                     << " to " << height << ". Clearing cache." << endl;
+
+                m_blocks_cache.clear();
+                m_txs_cache.clear();
+            }
+
+            update_blk_timestamps(height);
+
+            if (height != m_current_height)
+            {
+                m_current_height = height;
+            }
+        }
+        catch (const std::exception& e)
+        {
+            cerr << "Cant get blockchain height: " << e.what() << endl;
+            return false;
+        }
+
+        return true;
+    }
+
+
+    /**
+     * Start background thread that refreshes
+     * the blockchain height every refresh_interval
+     */
+    void
+    MicroCore::start_tip_tracker(std::chrono::seconds refresh_interval)
+    {
+        if (m_tip_tracker.joinable())
+        {
+            return;
+        }
+
+        m_tip_tracker_stop = false;
+
+        m_tip_tracker = std::thread([this, refresh_interval]()
+        {
+            std::unique_lock<std::mutex> lck (m_tip_tracker_mutex);
+
+            while (!m_tip_tracker_cv.wait_for(lck, refresh_interval,
+                                              [this]() { return m_tip_tracker_stop.load(); }))
+            {
+                refresh_current_blockchain_height();
+            }
+        });
+    }
+
+
+    /**
+     * Set max memory, in bytes, used for caching blocks and txs.
+     * The memory is split equally between the blocks and the txs.
+     *
+     * The memory is measured using blobs sizes, so the decoded
+     * blocks and txs take more memory than this.
+     */
+    void
+    MicroCore::set_cache_size(size_t cache_size)
+    {
+        m_blocks_cache.set_capacity(cache_size / 2);
+        m_txs_cache.set_capacity(cache_size / 2);
+    }
+
+
+    string
+    MicroCore::get_cache_stats()
+    {
+        return fmt::format("blocks cache: {:d} blocks, {:d} hits, {:d} misses; "
+                           "txs cache: {:d} txs, {:d} hits, {:d} misses",
+                           m_blocks_cache.size(), m_blocks_cache.hits(),
+                           m_blocks_cache.misses(),
+                           m_txs_cache.size(), m_txs_cache.hits(),
+                           m_txs_cache.misses());
+    }
+
+
+    bool
+    MicroCore::is_cacheable(uint64_t blk_height) const
+    {
+        return blk_height + CACHE_REORG_DEPTH < get_current_blockchain_height();
+    }
+
+
+    void
+    MicroCore::stop_tip_tracker()
+    {
+        if (!m_tip_tracker.joinable())
+        {
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lck (m_tip_tracker_mutex);
+            m_tip_tracker_stop = true;
+        }
+
+        m_tip_tracker_cv.notify_all();
+
+        m_tip_tracker.join();
+    }
+
 }
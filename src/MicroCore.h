@@ -6,9 +6,15 @@
 #define XMREG01_MICROCORE_H
 
 #include <iostream>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
 
 #include "monero_headers.h"
 #include "tx_details.h"
+#include "lru_cache.h"
 
 
 
@@ -33,7 +39,33 @@ namespace xmreg
         tx_memory_pool m_mempool;
         Blockchain m_blockchain_storage;
 
+        // chain tip tracker. Number of blocks in the blockchain
+        // is kept here and refreshed in the background, so
+        // that the pages dont need to read it from the database.
+        std::atomic<uint64_t> m_current_height {0};
+
+        std::thread             m_tip_tracker;
+        std::atomic<bool>       m_tip_tracker_stop {false};
+        std::mutex              m_tip_tracker_mutex;
+        std::condition_variable m_tip_tracker_cv;
+
+        // decoded blocks and txs. Only these that are at least
+        // CACHE_REORG_DEPTH blocks below the tip are cached, as
+        // they wont change anymore. Cost of an entry is its blob size.
+        sharded_lru_cache<uint64_t, block>           m_blocks_cache {0};
+        sharded_lru_cache<crypto::hash, transaction> m_txs_cache {0};
+
+        // timestamps of all blocks, indexed by height. Block timestamps
+        // are not always increasing, so each entry is the max timestamp
+        // up to its height, which makes the array sorted.
+        vector<uint64_t> m_blk_timestamps;
+        std::mutex       m_blk_timestamps_mutex;
+
     public:
+
+        // blocks that deep are assumed to never be reorganized
+        static const uint64_t CACHE_REORG_DEPTH {10};
+
         MicroCore();
 
         bool
@@ -57,6 +89,12 @@ namespace xmreg
         bool
         get_tx(const string& tx_hash, transaction& tx);
 
+        bool
+        get_txs(const vector<crypto::hash>& tx_hashes,
+                vector<transaction>& txs,
+                vector<crypto::hash>& missed_txs,
+                uint64_t blk_height = std::numeric_limits<uint64_t>::max());
+
         bool
         find_output_in_tx(const transaction& tx,
                           const public_key& output_pubkey,
@@ -72,9 +110,46 @@ namespace xmreg
         uint64_t
         get_blk_timestamp(uint64_t blk_height);
 
+        bool
+        get_height_by_timestamp(uint64_t timestamp, uint64_t& height);
+
         string
         get_blkchain_path();
 
+        uint64_t
+        get_current_blockchain_height() const;
+
+        bool
+        refresh_current_blockchain_height();
+
+        void
+        start_tip_tracker(std::chrono::seconds refresh_interval
+                                = std::chrono::seconds(5));
+
+        void
+        stop_tip_tracker();
+
+        void
+        set_cache_size(size_t cache_size);
+
+        string
+        get_cache_stats();
+
+    private:
+
+        bool
+        is_cacheable(uint64_t blk_height) const;
+
+        void
+        cache_tx(const crypto::hash& tx_hash,
+                 const transaction& tx,
+                 uint64_t blk_height);
+
+        bool
+        update_blk_timestamps(uint64_t height);
+
+    public:
+
 
         virtual ~MicroCore();
     };
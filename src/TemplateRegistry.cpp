@@ -0,0 +1,295 @@
+#include "TemplateRegistry.h"
+#include "tools.h"
+
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+
+namespace xmreg
+{
+
+    TemplateRegistry::TemplateRegistry(const string& _templates_dir,
+                                       const string& _partials_dir,
+                                       const string& _header_path,
+                                       const string& _footer_path)
+        : templates_dir {_templates_dir},
+          partials_dir {_partials_dir},
+          header_path {_header_path},
+          footer_path {_footer_path},
+          m_templates {make_shared<templates_set>()}
+    {}
+
+
+    /**
+     * Read all templates from templates and partials folders
+     * and replace currently used ones with them.
+     */
+    bool
+    TemplateRegistry::load()
+    {
+        shared_ptr<templates_set> new_templates = make_shared<templates_set>();
+
+        for (const string& dir: {templates_dir, partials_dir})
+        {
+            if (!bf::is_directory(dir))
+            {
+                cerr << "Templates folder does not exist: " << dir << endl;
+                return false;
+            }
+
+            for (bf::directory_iterator it {dir};
+                 it != bf::directory_iterator {}; ++it)
+            {
+                if (!bf::is_regular_file(it->status()))
+                {
+                    continue;
+                }
+
+                string template_path = dir + "/" + it->path().filename().string();
+
+                new_templates->templates[template_path]
+                        = make_shared<const string>(xmreg::read(template_path));
+            }
+        }
+
+        // header and footer are the same for all pages, so
+        // full pages can be made now, instead of for each request
+        auto header_tmpl = new_templates->templates.find(header_path);
+        auto footer_tmpl = new_templates->templates.find(footer_path);
+
+        if (header_tmpl == new_templates->templates.end()
+            || footer_tmpl == new_templates->templates.end())
+        {
+            cerr << "Header or footer template not found: "
+                 << header_path << ", " << footer_path << endl;
+            return false;
+        }
+
+        string header = *header_tmpl->second;
+        string footer = *footer_tmpl->second;
+
+        for (const auto& tmpl: new_templates->templates)
+        {
+            new_templates->full_pages[tmpl.first]
+                    = make_shared<const string>(header + *tmpl.second + footer);
+        }
+
+        for (const auto& tmpl: to_compile)
+        {
+            auto full_page = new_templates->full_pages.find(tmpl.first);
+
+            if (full_page == new_templates->full_pages.end())
+            {
+                cerr << "Template to compile not found: " << tmpl.first << endl;
+                continue;
+            }
+
+            map<string, string> partials;
+
+            for (const auto& partial: tmpl.second)
+            {
+                auto partial_tmpl = new_templates->templates.find(partial.second);
+
+                if (partial_tmpl == new_templates->templates.end())
+                {
+                    cerr << "Partial not found: " << partial.second << endl;
+                    continue;
+                }
+
+                partials[partial.first] = *partial_tmpl->second;
+            }
+
+            new_templates->compiled[tmpl.first]
+                    = make_shared<const mstch::compiled_template>(
+                            *full_page->second, partials);
+        }
+
+        std::atomic_store(&m_templates,
+                          shared_ptr<const templates_set>(new_templates));
+
+        return true;
+    }
+
+
+    shared_ptr<const TemplateRegistry::templates_set>
+    TemplateRegistry::current_templates() const
+    {
+        return std::atomic_load(&m_templates);
+    }
+
+
+    /**
+     * Get template of a given path, e.g., "./templates/block.html".
+     *
+     * Returns empty string if template was not loaded.
+     */
+    shared_ptr<const string>
+    TemplateRegistry::get(const string& template_path) const
+    {
+        shared_ptr<const templates_set> current = current_templates();
+
+        auto it = current->templates.find(template_path);
+
+        if (it == current->templates.end())
+        {
+            cerr << "Template not loaded: " << template_path << endl;
+            return make_shared<const string>();
+        }
+
+        return it->second;
+    }
+
+
+    /**
+     * Get template of a given path with header and footer added
+     */
+    shared_ptr<const string>
+    TemplateRegistry::get_full_page(const string& template_path) const
+    {
+        shared_ptr<const templates_set> current = current_templates();
+
+        auto it = current->full_pages.find(template_path);
+
+        if (it == current->full_pages.end())
+        {
+            cerr << "Template not loaded: " << template_path << endl;
+            return make_shared<const string>();
+        }
+
+        return it->second;
+    }
+
+
+    /**
+     * Mark full page of a given template to be kept compiled,
+     * together with its partials given as name -> path.
+     *
+     * Must be called before load().
+     */
+    void
+    TemplateRegistry::add_compiled(const string& template_path,
+                                   const map<string, string>& partials)
+    {
+        to_compile[template_path] = partials;
+    }
+
+
+    /**
+     * Get compiled full page of a given template. If the template
+     * was not added for compilation, it is compiled now.
+     */
+    shared_ptr<const mstch::compiled_template>
+    TemplateRegistry::get_compiled(const string& template_path) const
+    {
+        shared_ptr<const templates_set> current = current_templates();
+
+        auto it = current->compiled.find(template_path);
+
+        if (it == current->compiled.end())
+        {
+            return make_shared<const mstch::compiled_template>(
+                    *get_full_page(template_path));
+        }
+
+        return it->second;
+    }
+
+
+    /**
+     * Watch templates folders and reload all the templates
+     * when any of them changes. Meant for development, so that
+     * the templates can be edited without restarting the server.
+     */
+    bool
+    TemplateRegistry::start_watching()
+    {
+        if (m_watcher.joinable())
+        {
+            return true;
+        }
+
+        int inotify_fd = inotify_init1(IN_NONBLOCK);
+
+        if (inotify_fd < 0)
+        {
+            cerr << "Cant initialize inotify to watch templates" << endl;
+            return false;
+        }
+
+        uint32_t mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE;
+
+        for (const string& dir: {templates_dir, partials_dir})
+        {
+            if (inotify_add_watch(inotify_fd, dir.c_str(), mask) < 0)
+            {
+                cerr << "Cant watch templates folder: " << dir << endl;
+                close(inotify_fd);
+                return false;
+            }
+        }
+
+        m_watcher_stop = false;
+
+        m_watcher = std::thread(&TemplateRegistry::watch, this, inotify_fd);
+
+        return true;
+    }
+
+
+    void
+    TemplateRegistry::watch(int inotify_fd)
+    {
+        // inotify events have variable size
+        // so just read them into a large enough buffer
+        char buffer[4096];
+
+        pollfd pfd {inotify_fd, POLLIN, 0};
+
+        while (!m_watcher_stop)
+        {
+            // wake up every second to check if we should stop
+            int r = poll(&pfd, 1, 1000);
+
+            if (r <= 0)
+            {
+                continue;
+            }
+
+            bool changed {false};
+
+            while (::read(inotify_fd, buffer, sizeof(buffer)) > 0)
+            {
+                changed = true;
+            }
+
+            if (changed)
+            {
+                cout << "Templates changed. Reloading them." << endl;
+                load();
+            }
+        }
+
+        close(inotify_fd);
+    }
+
+
+    void
+    TemplateRegistry::stop_watching()
+    {
+        if (!m_watcher.joinable())
+        {
+            return;
+        }
+
+        m_watcher_stop = true;
+
+        m_watcher.join();
+    }
+
+
+    TemplateRegistry::~TemplateRegistry()
+    {
+        stop_watching();
+    }
+
+}
@@ -0,0 +1,109 @@
+#ifndef XMREG01_TEMPLATEREGISTRY_H
+#define XMREG01_TEMPLATEREGISTRY_H
+
+#include <string>
+#include <map>
+#include <memory>
+#include <thread>
+#include <atomic>
+
+#include "mstch/mstch.hpp"
+
+namespace xmreg
+{
+
+    using namespace std;
+
+    /**
+     * Keeps contents of all html templates in memory.
+     *
+     * Templates are read from the disk once, when the
+     * registry is loaded, and are kept as immutable strings.
+     * For each template, its full page, i.e., the template
+     * with header and footer added, is also prepared in advance.
+     *
+     * Templates are identified by their paths, e.g.,
+     * "./templates/block.html".
+     *
+     * Frequently rendered pages can be also kept as compiled
+     * mstch templates, so that they are not tokenized
+     * for each request.
+     *
+     * Optionally, for development, the templates folders can be
+     * watched using inotify and the templates reloaded on any change.
+     */
+    class TemplateRegistry
+    {
+        using templates_map = map<string, shared_ptr<const string>>;
+
+        struct templates_set
+        {
+            // templates as read from the disk
+            templates_map templates;
+
+            // header + template + footer
+            templates_map full_pages;
+
+            // full pages parsed by mstch together with their partials
+            map<string, shared_ptr<const mstch::compiled_template>> compiled;
+        };
+
+        // template path -> (partial name -> partial path)
+        // of the templates to be compiled
+        map<string, map<string, string>> to_compile;
+
+        string templates_dir;
+        string partials_dir;
+        string header_path;
+        string footer_path;
+
+        // current set of templates. Replaced as a whole
+        // when the templates are reloaded.
+        shared_ptr<const templates_set> m_templates;
+
+        std::thread       m_watcher;
+        std::atomic<bool> m_watcher_stop {false};
+
+    public:
+
+        TemplateRegistry(const string& _templates_dir,
+                         const string& _partials_dir,
+                         const string& _header_path,
+                         const string& _footer_path);
+
+        bool
+        load();
+
+        shared_ptr<const string>
+        get(const string& template_path) const;
+
+        shared_ptr<const string>
+        get_full_page(const string& template_path) const;
+
+        void
+        add_compiled(const string& template_path,
+                     const map<string, string>& partials = {});
+
+        shared_ptr<const mstch::compiled_template>
+        get_compiled(const string& template_path) const;
+
+        bool
+        start_watching();
+
+        void
+        stop_watching();
+
+        virtual ~TemplateRegistry();
+
+    private:
+
+        shared_ptr<const templates_set>
+        current_templates() const;
+
+        void
+        watch(int inotify_fd);
+    };
+
+}
+
+#endif //XMREG01_TEMPLATEREGISTRY_H
@@ -0,0 +1,396 @@
+#ifndef XMREG01_BLOOM_FILTER_H
+#define XMREG01_BLOOM_FILTER_H
+
+#include <string>
+#include <iostream>
+#include <cstring>
+#include <cstdio>
+#include <cstdint>
+#include <limits>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace xmreg
+{
+
+    using namespace std;
+
+    /**
+     * Blocked Bloom filter kept in a memory mapped file.
+     *
+     * Each key sets bits in only one 512 bit block, i.e., one
+     * cache line, so a lookup reads a single cache line. If any
+     * of the key's bits is not set, the key was never added.
+     *
+     * Keys can be added by one thread while other threads
+     * look up keys. Removing keys is not possible.
+     *
+     * The file is marked as not clean while it is open, so a
+     * filter left by a crash, with some of its bits possibly never
+     * written to the disk, is not taken as being in sync.
+     */
+    class bloom_filter
+    {
+        static const uint64_t MAGIC          {0x32746c6672786d78}; // "xmrflt2"
+        static const uint64_t BITS_PER_BLOCK {512};
+        static const uint64_t BITS_PER_KEY   {10};
+        static const uint64_t BITS_SET       {7};
+
+        // smallest number of keys a new filter is made for
+        static const uint64_t MIN_CAPACITY   {1 << 20};
+
+        struct header
+        {
+            uint64_t magic;
+            uint64_t no_of_blocks;
+
+            // number of keys the filter was sized for
+            uint64_t capacity;
+
+            // number of records in the filtered table when the
+            // filter was last updated. Used to check if the
+            // filter is in sync with its table.
+            uint64_t synced_entries;
+
+            // 1 if the filter was closed, i.e., all of
+            // it was written to the disk
+            uint64_t clean;
+        };
+
+        struct alignas(64) block_type
+        {
+            uint64_t words[BITS_PER_BLOCK / 64];
+        };
+
+        string path;
+
+        int    fd      {-1};
+        void*  mapped  {nullptr};
+        size_t mapped_size {0};
+
+        header*     hdr    {nullptr};
+        block_type* blocks {nullptr};
+
+    public:
+
+        // synced_entries of a filter not in sync with any table
+        static const uint64_t NOT_SYNCED {std::numeric_limits<uint64_t>::max()};
+
+        bloom_filter() = default;
+
+        bloom_filter(const bloom_filter&) = delete;
+        bloom_filter& operator=(const bloom_filter&) = delete;
+
+        /**
+         * Map filter from a given file. If the file does not
+         * exist or was made for fewer keys than no_of_keys, a new
+         * empty filter is made, with room for twice as many keys.
+         *
+         * Returns false if the file cant be opened or mapped.
+         */
+        bool
+        open(const string& _path, uint64_t no_of_keys)
+        {
+            close();
+
+            path = _path;
+
+            fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0664);
+
+            if (fd < 0)
+            {
+                cerr << "Cant open filter file: " << path << endl;
+                return false;
+            }
+
+            struct stat st;
+
+            if (fstat(fd, &st) != 0)
+            {
+                cerr << "Cant stat filter file: " << path << endl;
+                close();
+                return false;
+            }
+
+            if (static_cast<size_t>(st.st_size) >= sizeof(header)
+                && map_file(st.st_size)
+                && hdr->magic == MAGIC
+                && hdr->capacity >= no_of_keys
+                && mapped_size == file_size(hdr->no_of_blocks))
+            {
+                if (!hdr->clean)
+                {
+                    set_synced_entries(NOT_SYNCED);
+                }
+
+                return mark_not_clean();
+            }
+
+            // no usable filter in the file, so make a new one
+            uint64_t new_capacity = 2 * no_of_keys;
+
+            if (new_capacity < MIN_CAPACITY)
+            {
+                new_capacity = MIN_CAPACITY;
+            }
+
+            return create(new_capacity);
+        }
+
+        bool
+        is_open() const
+        {
+            return mapped != nullptr;
+        }
+
+        /**
+         * Make the filter empty, sized for a given number of keys
+         */
+        bool
+        create(uint64_t _capacity)
+        {
+            unmap();
+
+            uint64_t no_of_blocks = _capacity * BITS_PER_KEY / BITS_PER_BLOCK + 1;
+
+            size_t size = file_size(no_of_blocks);
+
+            if (ftruncate(fd, 0) != 0 || ftruncate(fd, size) != 0)
+            {
+                cerr << "Cant resize filter file: " << path << endl;
+                return false;
+            }
+
+            if (!map_file(size))
+            {
+                return false;
+            }
+
+            hdr->magic          = MAGIC;
+            hdr->no_of_blocks   = no_of_blocks;
+            hdr->capacity       = _capacity;
+            hdr->synced_entries = 0;
+
+            return mark_not_clean();
+        }
+
+        /**
+         * Move the filter file to a given path, replacing file
+         * at that path, if any. The filter stays mapped.
+         */
+        bool
+        rename(const string& new_path)
+        {
+            if (std::rename(path.c_str(), new_path.c_str()) != 0)
+            {
+                cerr << "Cant rename filter file: " << path
+                     << " to " << new_path << endl;
+                return false;
+            }
+
+            path = new_path;
+
+            return true;
+        }
+
+        void
+        add(const void* key, size_t size)
+        {
+            uint64_t h = hash(key, size);
+
+            block_type& block = blocks[h % hdr->no_of_blocks];
+
+            uint64_t h1 = h >> 32;
+            uint64_t h2 = (h & 0xffffffff) | 1;
+
+            for (uint64_t i = 0; i < BITS_SET; ++i)
+            {
+                uint64_t bit = (h1 + i * h2) % BITS_PER_BLOCK;
+
+                __atomic_fetch_or(&block.words[bit / 64], 1ULL << (bit % 64),
+                                  __ATOMIC_RELAXED);
+            }
+        }
+
+        void
+        add(const string& key)
+        {
+            add(key.data(), key.size());
+        }
+
+        /**
+         * False if the key was never added. True if it
+         * was added, or, rarely, if it was not.
+         */
+        bool
+        might_contain(const void* key, size_t size) const
+        {
+            uint64_t h = hash(key, size);
+
+            const block_type& block = blocks[h % hdr->no_of_blocks];
+
+            uint64_t h1 = h >> 32;
+            uint64_t h2 = (h & 0xffffffff) | 1;
+
+            for (uint64_t i = 0; i < BITS_SET; ++i)
+            {
+                uint64_t bit = (h1 + i * h2) % BITS_PER_BLOCK;
+
+                uint64_t word = __atomic_load_n(&block.words[bit / 64],
+                                                __ATOMIC_RELAXED);
+
+                if ((word & (1ULL << (bit % 64))) == 0)
+                {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+        bool
+        might_contain(const string& key) const
+        {
+            return might_contain(key.data(), key.size());
+        }
+
+        uint64_t
+        capacity() const
+        {
+            return hdr->capacity;
+        }
+
+        uint64_t
+        synced_entries() const
+        {
+            return __atomic_load_n(&hdr->synced_entries, __ATOMIC_ACQUIRE);
+        }
+
+        void
+        set_synced_entries(uint64_t entries)
+        {
+            __atomic_store_n(&hdr->synced_entries, entries, __ATOMIC_RELEASE);
+        }
+
+        /**
+         * Write the filter to the disk, mark it as clean and unmap it
+         */
+        void
+        close()
+        {
+            if (mapped && msync(mapped, mapped_size, MS_SYNC) == 0)
+            {
+                hdr->clean = 1;
+                msync(mapped, sizeof(block_type), MS_SYNC);
+            }
+
+            unmap();
+
+            if (fd >= 0)
+            {
+                ::close(fd);
+                fd = -1;
+            }
+        }
+
+        ~bloom_filter()
+        {
+            close();
+        }
+
+    private:
+
+        /**
+         * Mark the file as not clean on the disk, before
+         * any bits are set in it
+         */
+        bool
+        mark_not_clean()
+        {
+            hdr->clean = 0;
+
+            if (msync(mapped, sizeof(block_type), MS_SYNC) != 0)
+            {
+                cerr << "Cant write filter file: " << path << endl;
+                return false;
+            }
+
+            return true;
+        }
+
+        static size_t
+        file_size(uint64_t no_of_blocks)
+        {
+            // blocks start at a cache line boundary
+            return sizeof(block_type) + no_of_blocks * sizeof(block_type);
+        }
+
+        bool
+        map_file(size_t size)
+        {
+            mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+            if (mapped == MAP_FAILED)
+            {
+                cerr << "Cant map filter file: " << path << endl;
+                mapped = nullptr;
+                return false;
+            }
+
+            mapped_size = size;
+
+            hdr    = static_cast<header*>(mapped);
+            blocks = reinterpret_cast<block_type*>(
+                    static_cast<char*>(mapped) + sizeof(block_type));
+
+            return true;
+        }
+
+        void
+        unmap()
+        {
+            if (mapped)
+            {
+                munmap(mapped, mapped_size);
+            }
+
+            mapped      = nullptr;
+            mapped_size = 0;
+            hdr         = nullptr;
+            blocks      = nullptr;
+        }
+
+        /**
+         * 64 bit FNV-1a with a final mix of the bits. The filter
+         * is kept on the disk, so the hash must not change
+         * between builds, as std::hash can.
+         */
+        static uint64_t
+        hash(const void* key, size_t size)
+        {
+            const unsigned char* bytes = static_cast<const unsigned char*>(key);
+
+            uint64_t h = 0xcbf29ce484222325ULL;
+
+            for (size_t i = 0; i < size; ++i)
+            {
+                h ^= bytes[i];
+                h *= 0x100000001b3ULL;
+            }
+
+            h ^= h >> 33;
+            h *= 0xff51afd7ed558ccdULL;
+            h ^= h >> 33;
+            h *= 0xc4ceb3fe1a85ec53ULL;
+            h ^= h >> 33;
+
+            return h;
+        }
+    };
+
+}
+
+#endif //XMREG01_BLOOM_FILTER_H
@@ -0,0 +1,278 @@
+#ifndef XMREG01_LRU_CACHE_H
+#define XMREG01_LRU_CACHE_H
+
+#include <list>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <functional>
+
+namespace xmreg
+{
+
+    using namespace std;
+
+    /**
+     * Thread-safe least recently used cache.
+     *
+     * Each element has a cost, by default 1. Sum of costs
+     * of all elements is kept below capacity, i.e., with the
+     * default cost capacity is simply the max number of elements.
+     * When full, elements used longest time ago are removed.
+     */
+    template <typename Key, typename Value, typename Hash = std::hash<Key>>
+    class lru_cache
+    {
+        struct item_type
+        {
+            Key key;
+            Value value;
+            size_t cost;
+        };
+
+        using items_list = list<item_type>;
+
+        size_t capacity;
+        size_t total_cost {0};
+
+        // most recently used items are at the front
+        items_list items;
+
+        unordered_map<Key, typename items_list::iterator, Hash> items_map;
+
+        mutable std::mutex m_mutex;
+
+        std::atomic<uint64_t> no_of_hits {0};
+        std::atomic<uint64_t> no_of_misses {0};
+
+    public:
+
+        explicit lru_cache(size_t _capacity)
+            : capacity {_capacity}
+        {}
+
+        lru_cache(const lru_cache&) = delete;
+        lru_cache& operator=(const lru_cache&) = delete;
+
+        /**
+         * Copy value of a given key into value.
+         *
+         * Returns false if the key is not in the cache.
+         */
+        bool
+        get(const Key& key, Value& value)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            auto it = items_map.find(key);
+
+            if (it == items_map.end())
+            {
+                ++no_of_misses;
+                return false;
+            }
+
+            ++no_of_hits;
+
+            // mark as most recently used
+            items.splice(items.begin(), items, it->second);
+
+            value = it->second->value;
+
+            return true;
+        }
+
+        void
+        put(const Key& key, const Value& value, size_t cost = 1)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            if (cost > capacity)
+            {
+                return;
+            }
+
+            auto it = items_map.find(key);
+
+            if (it != items_map.end())
+            {
+                total_cost -= it->second->cost;
+                items.erase(it->second);
+                items_map.erase(it);
+            }
+
+            items.push_front(item_type {key, value, cost});
+            items_map[key] = items.begin();
+
+            total_cost += cost;
+
+            evict();
+        }
+
+        void
+        set_capacity(size_t _capacity)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            capacity = _capacity;
+            evict();
+        }
+
+        size_t
+        size() const
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return items_map.size();
+        }
+
+        size_t
+        cost() const
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return total_cost;
+        }
+
+        uint64_t
+        hits() const
+        {
+            return no_of_hits;
+        }
+
+        uint64_t
+        misses() const
+        {
+            return no_of_misses;
+        }
+
+        void
+        clear()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            items_map.clear();
+            items.clear();
+            total_cost = 0;
+        }
+
+    private:
+
+        // must be called with m_mutex locked
+        void
+        evict()
+        {
+            while (total_cost > capacity && !items.empty())
+            {
+                total_cost -= items.back().cost;
+                items_map.erase(items.back().key);
+                items.pop_back();
+            }
+        }
+    };
+
+
+    /**
+     * lru_cache split into a number of independent shards,
+     * each with its own mutex, so that many threads
+     * using the cache dont wait for each other.
+     *
+     * Capacity is divided equally between the shards.
+     */
+    template <typename Key, typename Value, typename Hash = std::hash<Key>>
+    class sharded_lru_cache
+    {
+        using shard_type = lru_cache<Key, Value, Hash>;
+
+        vector<unique_ptr<shard_type>> shards;
+
+        Hash hasher;
+
+    public:
+
+        sharded_lru_cache(size_t _capacity, size_t no_of_shards = 16)
+        {
+            for (size_t i = 0; i < no_of_shards; ++i)
+            {
+                shards.emplace_back(new shard_type(_capacity / no_of_shards));
+            }
+        }
+
+        bool
+        get(const Key& key, Value& value)
+        {
+            return shard(key).get(key, value);
+        }
+
+        void
+        put(const Key& key, const Value& value, size_t cost = 1)
+        {
+            shard(key).put(key, value, cost);
+        }
+
+        void
+        set_capacity(size_t _capacity)
+        {
+            for (auto& a_shard: shards)
+            {
+                a_shard->set_capacity(_capacity / shards.size());
+            }
+        }
+
+        size_t
+        size() const
+        {
+            return sum(&shard_type::size);
+        }
+
+        size_t
+        cost() const
+        {
+            return sum(&shard_type::cost);
+        }
+
+        uint64_t
+        hits() const
+        {
+            return sum(&shard_type::hits);
+        }
+
+        uint64_t
+        misses() const
+        {
+            return sum(&shard_type::misses);
+        }
+
+        void
+        clear()
+        {
+            for (auto& a_shard: shards)
+            {
+                a_shard->clear();
+            }
+        }
+
+    private:
+
+        shard_type&
+        shard(const Key& key)
+        {
+            return *shards[hasher(key) % shards.size()];
+        }
+
+        template <typename T>
+        T
+        sum(T (shard_type::*getter)() const) const
+        {
+            T total {0};
+
+            for (const auto& a_shard: shards)
+            {
+                total += ((*a_shard).*getter)();
+            }
+
+            return total;
+        }
+    };
+
+}
+
+#endif //XMREG01_LRU_CACHE_H
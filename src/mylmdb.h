@@ -6,8 +6,15 @@
 
 #include "../ext/lmdb++.h"
 
+#include "bloom_filter.h"
+
 #include <iostream>
 #include <memory>
+#include <mutex>
+#include <map>
+#include <set>
+#include <tuple>
+#include <algorithm>
 
 namespace xmreg
 {
@@ -33,7 +40,7 @@ namespace xmreg
         uint64_t           index_in_tx;
     };
 
-    std::ostream& operator<<(std::ostream& os, const output_info&  out_info)
+    inline std::ostream& operator<<(std::ostream& os, const output_info&  out_info)
     {
          os  << ", out_pub_key: " << out_info.out_pub_key
              << ", tx_hash: " << out_info.tx_hash
@@ -44,13 +51,105 @@ namespace xmreg
         return os;
     }
 
+    /**
+     * What a value in the key index is
+     */
+    enum key_kind : uint64_t
+    {
+        KEY_TX_HASH = 0,
+        KEY_BLOCK_HASH,
+        KEY_KEY_IMAGE,
+        KEY_TX_PUB_KEY,
+        KEY_PAYMENT_ID,
+        KEY_ENCRYPTED_PAYMENT_ID,
+        KEY_OUTPUT_PUB_KEY
+    };
+
+    /**
+     * Entry of the key index. Says what a given 32 byte
+     * value is, and in which tx or block it can be found.
+     */
+    struct key_index_entry
+    {
+        uint64_t     kind;
+        crypto::hash tx_hash;     // null_hash for block hashes
+        uint64_t     blk_height;
+    };
+
+    /**
+     * Name of a key kind. Same as name of the table that
+     * keeps the values of the kind, e.g., "key_images".
+     */
+    inline string
+    key_kind_to_str(uint64_t kind)
+    {
+        switch (kind)
+        {
+            case KEY_TX_HASH:              return "tx_hashes";
+            case KEY_BLOCK_HASH:           return "block_hashes";
+            case KEY_KEY_IMAGE:            return "key_images";
+            case KEY_TX_PUB_KEY:           return "tx_public_keys";
+            case KEY_PAYMENT_ID:           return "payments_id";
+            case KEY_ENCRYPTED_PAYMENT_ID: return "encrypted_payments_id";
+            case KEY_OUTPUT_PUB_KEY:       return "output_public_keys";
+        }
+
+        return "unknown";
+    }
+
+    /**
+     * Key of the key index for a value shorter than 32 bytes,
+     * i.e., encrypted payment id, padded with zeros.
+     */
+    template <typename T>
+    crypto::hash
+    to_index_key(const T& value)
+    {
+        static_assert(sizeof(T) <= sizeof(crypto::hash),
+                      "Value too large for key index");
+
+        crypto::hash key = null_hash;
+
+        memcpy(&key, &value, sizeof(T));
+
+        return key;
+    }
+
+    /**
+     * Single key and value to be written to a table
+     */
+    struct db_record
+    {
+        string table;
+        string key;
+        string value;
+    };
+
     class MyLMDB
     {
 
 
         static const uint64_t DEFAULT_MAPSIZE = 30UL * 1024UL * 1024UL * 1024UL; /* 30 GiB */
-        static const uint64_t DEFAULT_NO_DBs  = 10;
-
+        static const uint64_t DEFAULT_NO_DBs  = 20;
+
+        // number of last indexed blocks whose records are
+        // kept, so that they can be removed after a reorg
+        static const uint64_t MAX_UNDO_DEPTH  = 100;
+
+        // key of the indexed height in "indexer_state"
+        static constexpr const char* INDEXED_HEIGHT_KEY = "indexed_height";
+
+        /**
+         * Read only transaction together with cursors
+         * opened in it. When not used, the transaction is
+         * reset and kept for reuse, so next lookup just
+         * renews it and its cursors.
+         */
+        struct cached_read_txn
+        {
+            lmdb::txn txn {nullptr};
+            map<MDB_dbi, lmdb::cursor> cursors;
+        };
 
         string m_db_path;
 
@@ -59,8 +158,95 @@ namespace xmreg
 
         lmdb::env m_env;
 
+        // handles of all tables, opened once when env is opened
+        map<string, MDB_dbi> m_dbis;
+
+        // reset read transactions ready to be reused
+        vector<unique_ptr<cached_read_txn>> m_idle_rtxns;
+        std::mutex m_rtxns_mutex;
+
+        // bloom filters of tables with hashes and keys, so that
+        // keys not in a table dont need any lmdb lookup. Tables are
+        // set when env is opened. A filter can be replaced by a
+        // bigger one, or removed, so they are accessed using
+        // atomic_load and atomic_store.
+        map<string, shared_ptr<bloom_filter>> m_filters;
+
 
     public:
+
+        /**
+         * Read only access to the database.
+         *
+         * Takes an idle read transaction from the MyLMDB
+         * (or begins a new one if there is none) and gives it
+         * back when the session ends. Cursors are opened once per
+         * table and reused by later sessions.
+         *
+         * A session should be used by one thread at a time.
+         */
+        class read_session
+        {
+            MyLMDB& m_db;
+            unique_ptr<cached_read_txn> m_rtxn;
+
+            // cursors already renewed in this session
+            set<MDB_dbi> m_renewed_cursors;
+
+        public:
+            read_session(MyLMDB& _db)
+                : m_db {_db}, m_rtxn {_db.acquire_read_txn()}
+            {}
+
+            read_session(const read_session&) = delete;
+            read_session& operator=(const read_session&) = delete;
+
+            ~read_session()
+            {
+                m_db.release_read_txn(std::move(m_rtxn));
+            }
+
+            MDB_txn*
+            txn() const
+            {
+                return m_rtxn->txn;
+            }
+
+            MDB_dbi
+            dbi(const string& db_name) const
+            {
+                return m_db.get_dbi(db_name);
+            }
+
+            /**
+             * Cursor for a given table. The same cursor
+             * is returned for the same table within
+             * the session.
+             */
+            lmdb::cursor&
+            cursor(const string& db_name)
+            {
+                MDB_dbi table = dbi(db_name);
+
+                auto it = m_rtxn->cursors.find(table);
+
+                if (it == m_rtxn->cursors.end())
+                {
+                    it = m_rtxn->cursors.emplace(
+                            table, lmdb::cursor::open(txn(), table)).first;
+
+                    m_renewed_cursors.insert(table);
+                }
+                else if (!m_renewed_cursors.count(table))
+                {
+                    it->second.renew(txn());
+                    m_renewed_cursors.insert(table);
+                }
+
+                return it->second;
+            }
+        };
+
         MyLMDB(string _path,
                uint64_t _mapsize = DEFAULT_MAPSIZE,
                uint64_t _no_dbs = DEFAULT_NO_DBs)
@@ -72,6 +258,17 @@ namespace xmreg
             create_and_open_env();
         }
 
+        MyLMDB(const MyLMDB&) = delete;
+        MyLMDB& operator=(const MyLMDB&) = delete;
+
+        ~MyLMDB()
+        {
+            // read transactions and their cursors
+            // must be closed before the env
+            std::lock_guard<std::mutex> lck (m_rtxns_mutex);
+            m_idle_rtxns.clear();
+        }
+
         bool
         create_and_open_env()
         {
@@ -79,7 +276,14 @@ namespace xmreg
             {   m_env = lmdb::env::create();
                 m_env.set_mapsize(m_mapsize);
                 m_env.set_max_dbs(m_no_dbs);
-                m_env.open(m_db_path.c_str(), MDB_CREATE, 0664);
+
+                // MDB_NOTLS, so that reset read transactions can
+                // be reused by any thread
+                m_env.open(m_db_path.c_str(), MDB_CREATE | MDB_NOTLS, 0664);
+
+                open_dbis();
+
+                open_filters();
             }
             catch (lmdb::error& e )
             {
@@ -90,6 +294,315 @@ namespace xmreg
             return true;
         }
 
+        /**
+         * Open handles of all the tables. They stay valid
+         * for as long as env is open, so lookups dont need
+         * to open them again.
+         */
+        void
+        open_dbis()
+        {
+            unsigned int flags = MDB_CREATE | MDB_DUPSORT | MDB_DUPFIXED;
+
+            const vector<pair<string, unsigned int>> tables {
+                {"key_images"           , flags},
+                {"tx_public_keys"       , flags},
+                {"payments_id"          , flags},
+                {"encrypted_payments_id", flags},
+                {"output_public_keys"   , flags},
+                {"output_amounts"       , flags},
+                {"output_info"          , flags | MDB_INTEGERKEY | MDB_INTEGERDUP},
+                {"output_info_by_height", flags | MDB_INTEGERKEY},
+                {"block_timestamps"     , MDB_CREATE | MDB_INTEGERKEY},
+                {"scan_checkpoints"     , MDB_CREATE},
+                {"key_index"            , flags},
+                {"indexed_blocks"       , MDB_CREATE | MDB_INTEGERKEY},
+                {"indexer_state"        , MDB_CREATE}
+            };
+
+            lmdb::txn wtxn = lmdb::txn::begin(m_env);
+
+            for (const auto& table: tables)
+            {
+                m_dbis[table.first] = lmdb::dbi::open(
+                        wtxn, table.first.c_str(), table.second).handle();
+            }
+
+            wtxn.commit();
+        }
+
+        /**
+         * Map bloom filters of tables searched by keys, kept
+         * next to the database as "<table>.bloom" files.
+         *
+         * A filter not in sync with its table, e.g., because the
+         * table was written by other program, is built again
+         * from all keys of the table.
+         */
+        void
+        open_filters()
+        {
+            const vector<string> tables {
+                "key_images", "tx_public_keys", "payments_id",
+                "encrypted_payments_id", "output_public_keys", "key_index"
+            };
+
+            lmdb::txn rtxn = lmdb::txn::begin(m_env, nullptr, MDB_RDONLY);
+
+            for (const string& table: tables)
+            {
+                lmdb::dbi rdbi {get_dbi(table)};
+
+                uint64_t entries = rdbi.size(rtxn);
+
+                shared_ptr<bloom_filter> filter = make_shared<bloom_filter>();
+
+                if (!filter->open(filter_path(table), entries))
+                {
+                    m_filters[table] = nullptr;
+                    continue;
+                }
+
+                if (filter->synced_entries() != entries)
+                {
+                    cout << "Building filter of table " << table << endl;
+
+                    if (!filter->create(filter->capacity())
+                        || !fill_filter(*filter, table, rtxn))
+                    {
+                        m_filters[table] = nullptr;
+                        continue;
+                    }
+                }
+
+                m_filters[table] = filter;
+            }
+
+            rtxn.abort();
+        }
+
+        string
+        filter_path(const string& db_name) const
+        {
+            return m_db_path + "/" + db_name + ".bloom";
+        }
+
+        /**
+         * Add all keys of a table, as seen in a given
+         * txn, to an empty filter
+         */
+        bool
+        fill_filter(bloom_filter& filter, const string& db_name, MDB_txn* txn)
+        {
+            lmdb::dbi dbi {get_dbi(db_name)};
+
+            uint64_t entries = dbi.size(txn);
+
+            if (entries > filter.capacity())
+            {
+                return false;
+            }
+
+            lmdb::cursor cr = lmdb::cursor::open(txn, dbi);
+
+            lmdb::val key_val;
+            lmdb::val data_val;
+
+            while (cr.get(key_val, data_val, MDB_NEXT_NODUP))
+            {
+                filter.add(key_val.data(), key_val.size());
+            }
+
+            filter.set_synced_entries(entries);
+
+            return true;
+        }
+
+        shared_ptr<bloom_filter>
+        get_filter(const string& db_name) const
+        {
+            auto it = m_filters.find(db_name);
+
+            if (it == m_filters.end())
+            {
+                return nullptr;
+            }
+
+            return std::atomic_load(&it->second);
+        }
+
+        /**
+         * False if the key is surely not in a given table, as
+         * seen in a given txn. Tables without a filter, or whose
+         * filter is not in sync with them, e.g., because other
+         * program wrote to them, can contain any key.
+         */
+        bool
+        might_contain(const string& db_name, const void* key, size_t size,
+                      MDB_txn* txn) const
+        {
+            shared_ptr<bloom_filter> filter = get_filter(db_name);
+
+            if (!filter)
+            {
+                return true;
+            }
+
+            lmdb::dbi dbi {get_dbi(db_name)};
+
+            if (filter->synced_entries() != dbi.size(txn))
+            {
+                return true;
+            }
+
+            return filter->might_contain(key, size);
+        }
+
+        /**
+         * Tables whose filters are in sync with them. Checked at
+         * the start of a write txn, so that sync_filter does not
+         * mark as in sync a filter without keys written
+         * by other program.
+         */
+        set<string>
+        get_synced_filters(MDB_txn* wtxn) const
+        {
+            set<string> synced;
+
+            for (const auto& table_filter: m_filters)
+            {
+                shared_ptr<bloom_filter> filter = get_filter(table_filter.first);
+
+                lmdb::dbi wdbi {get_dbi(table_filter.first)};
+
+                if (filter && filter->synced_entries() == wdbi.size(wtxn))
+                {
+                    synced.insert(table_filter.first);
+                }
+            }
+
+            return synced;
+        }
+
+        /**
+         * Add key written to a table to the table's filter
+         */
+        void
+        add_to_filter(const string& db_name, const void* key, size_t size)
+        {
+            shared_ptr<bloom_filter> filter = get_filter(db_name);
+
+            if (filter)
+            {
+                filter->add(key, size);
+            }
+        }
+
+        /**
+         * Mark filter of a table as being in sync with it. Called
+         * before commit of txn that added keys to the table.
+         *
+         * Filters not in sync at the start of the txn are left as
+         * they are. A filter with more entries than it was made for
+         * is replaced by a new, twice as big one.
+         */
+        void
+        sync_filter(const string& db_name, MDB_txn* wtxn,
+                    const set<string>& synced_filters)
+        {
+            shared_ptr<bloom_filter> filter = get_filter(db_name);
+
+            if (!filter || !synced_filters.count(db_name))
+            {
+                return;
+            }
+
+            lmdb::dbi wdbi {get_dbi(db_name)};
+
+            uint64_t entries = wdbi.size(wtxn);
+
+            if (entries <= filter->capacity())
+            {
+                filter->set_synced_entries(entries);
+                return;
+            }
+
+            cout << "Building bigger filter of table " << db_name << endl;
+
+            shared_ptr<bloom_filter> new_filter = make_shared<bloom_filter>();
+
+            string path = filter_path(db_name);
+
+            if (!new_filter->open(path + ".new", 0)
+                || !new_filter->create(2 * entries)
+                || !fill_filter(*new_filter, db_name, wtxn)
+                || !new_filter->rename(path))
+            {
+                cerr << "Cant build filter of table " << db_name
+                     << ". Table will be used without it." << endl;
+
+                new_filter = nullptr;
+            }
+
+            std::atomic_store(&m_filters[db_name], new_filter);
+        }
+
+        MDB_dbi
+        get_dbi(const string& db_name) const
+        {
+            auto it = m_dbis.find(db_name);
+
+            if (it == m_dbis.end())
+            {
+                throw lmdb::runtime_error(
+                        ("Unknown table: " + db_name).c_str(), MDB_NOTFOUND);
+            }
+
+            return it->second;
+        }
+
+        unique_ptr<cached_read_txn>
+        acquire_read_txn()
+        {
+            unique_ptr<cached_read_txn> rtxn;
+
+            {
+                std::lock_guard<std::mutex> lck (m_rtxns_mutex);
+
+                if (!m_idle_rtxns.empty())
+                {
+                    rtxn = std::move(m_idle_rtxns.back());
+                    m_idle_rtxns.pop_back();
+                }
+            }
+
+            if (rtxn)
+            {
+                rtxn->txn.renew();
+                return rtxn;
+            }
+
+            rtxn.reset(new cached_read_txn);
+
+            rtxn->txn = lmdb::txn::begin(m_env, nullptr, MDB_RDONLY);
+
+            return rtxn;
+        }
+
+        void
+        release_read_txn(unique_ptr<cached_read_txn> rtxn)
+        {
+            if (!rtxn)
+            {
+                return;
+            }
+
+            rtxn->txn.reset();
+
+            std::lock_guard<std::mutex> lck (m_rtxns_mutex);
+            m_idle_rtxns.push_back(std::move(rtxn));
+        }
+
 
         bool
         write_key_images(const transaction& tx)
@@ -104,12 +617,16 @@ namespace xmreg
             lmdb::txn wtxn {nullptr};
             lmdb::dbi wdbi {0};
 
+            set<string> synced_filters;
+
             unsigned int flags = MDB_CREATE | MDB_DUPSORT | MDB_DUPFIXED;
 
             try
             {
                 wtxn = lmdb::txn::begin(m_env);
                 wdbi  = lmdb::dbi::open(wtxn, "key_images", flags);
+
+                synced_filters = get_synced_filters(wtxn);
             }
             catch (lmdb::error& e )
             {
@@ -125,10 +642,14 @@ namespace xmreg
                 lmdb::val tx_hash_val {tx_hash_str};
 
                 wdbi.put(wtxn, key_img_val, tx_hash_val);
+
+                add_to_filter("key_images", key_img_str.data(), key_img_str.size());
             }
 
             try
             {
+                sync_filter("key_images", wtxn, synced_filters);
+
                 wtxn.commit();
             }
             catch (lmdb::error& e )
@@ -140,8 +661,20 @@ namespace xmreg
             return true;
         }
 
+        /**
+         * Write output public keys, amounts and output_info
+         * of a given tx.
+         *
+         * output_info is saved twice: keyed by block's timestamp (legacy
+         * "output_info" table) and keyed by block height
+         * ("output_info_by_height" table). Timestamp of the block
+         * is saved in "block_timestamps" keyed by height too, so that
+         * scanning for outputs does not need to read the blockchain.
+         */
         bool
-        write_output_public_keys(const transaction& tx, const block& blk)
+        write_output_public_keys(const transaction& tx,
+                                 const block& blk,
+                                 uint64_t blk_height)
         {
             crypto::hash tx_hash = get_transaction_hash(tx);
 
@@ -156,6 +689,10 @@ namespace xmreg
             lmdb::dbi wdbi1 {0};
             lmdb::dbi wdbi2 {0};
             lmdb::dbi wdbi3 {0};
+            lmdb::dbi wdbi4 {0};
+            lmdb::dbi wdbi5 {0};
+
+            set<string> synced_filters;
 
             unsigned int flags = MDB_CREATE | MDB_DUPSORT | MDB_DUPFIXED;
 
@@ -166,6 +703,12 @@ namespace xmreg
                 wdbi2 = lmdb::dbi::open(wtxn, "output_amounts", flags);
                 wdbi3 = lmdb::dbi::open(wtxn, "output_info",
                                         flags | MDB_INTEGERKEY | MDB_INTEGERDUP);
+                wdbi4 = lmdb::dbi::open(wtxn, "output_info_by_height",
+                                        flags | MDB_INTEGERKEY);
+                wdbi5 = lmdb::dbi::open(wtxn, "block_timestamps",
+                                        MDB_CREATE | MDB_INTEGERKEY);
+
+                synced_filters = get_synced_filters(wtxn);
             }
             catch (lmdb::error& e )
             {
@@ -198,9 +741,30 @@ namespace xmreg
                 lmdb::val out_info_val          {static_cast<void*>(&out_info),
                                                  sizeof(out_info)};
 
+                lmdb::val blk_height_val        {static_cast<void*>(&blk_height),
+                                                 sizeof(blk_height)};
+
                 wdbi1.put(wtxn, public_key_val, tx_hash_val);
                 wdbi2.put(wtxn, public_key_val, amount_val);
                 wdbi3.put(wtxn, out_timestamp_val, out_info_val);
+                wdbi4.put(wtxn, blk_height_val, out_info_val);
+
+                add_to_filter("output_public_keys",
+                              public_key_str.data(), public_key_str.size());
+            }
+
+            try
+            {
+                uint64_t blk_timestamp = blk.timestamp;
+
+                wdbi5.put(wtxn, blk_height, blk_timestamp);
+
+                sync_filter("output_public_keys", wtxn, synced_filters);
+            }
+            catch (lmdb::error& e )
+            {
+                cerr << e.what() << endl;
+                return false;
             }
 
             try
@@ -234,6 +798,8 @@ namespace xmreg
                 lmdb::txn wtxn = lmdb::txn::begin(m_env);
                 lmdb::dbi wdbi = lmdb::dbi::open(wtxn, "tx_public_keys", flags);
 
+                set<string> synced_filters = get_synced_filters(wtxn);
+
                 //cout << "Saving public_key: " << pk_str << endl;
 
                 lmdb::val public_key_val {pk_str};
@@ -241,6 +807,9 @@ namespace xmreg
 
                 wdbi.put(wtxn, public_key_val, tx_hash_val);
 
+                add_to_filter("tx_public_keys", pk_str.data(), pk_str.size());
+                sync_filter("tx_public_keys", wtxn, synced_filters);
+
                 wtxn.commit();
             }
             catch (lmdb::error& e)
@@ -278,6 +847,8 @@ namespace xmreg
                 lmdb::txn wtxn = lmdb::txn::begin(m_env);
                 lmdb::dbi wdbi = lmdb::dbi::open(wtxn, "payments_id", flags);
 
+                set<string> synced_filters = get_synced_filters(wtxn);
+
                 //cout << "Saving payiment_id: " << payment_id_str << endl;
 
                 lmdb::val payment_id_val {payment_id_str};
@@ -285,6 +856,9 @@ namespace xmreg
 
                 wdbi.put(wtxn, payment_id_val, tx_hash_val);
 
+                add_to_filter("payments_id", payment_id_str.data(), payment_id_str.size());
+                sync_filter("payments_id", wtxn, synced_filters);
+
                 wtxn.commit();
             }
             catch (lmdb::error& e)
@@ -322,6 +896,8 @@ namespace xmreg
                 lmdb::txn wtxn = lmdb::txn::begin(m_env);
                 lmdb::dbi wdbi = lmdb::dbi::open(wtxn, "encrypted_payments_id", flags);
 
+                set<string> synced_filters = get_synced_filters(wtxn);
+
                 //cout << "Saving encrypted payiment_id: " << payment_id_str << endl;
                 //string wait_for_enter;
                 //cin >> wait_for_enter;
@@ -331,6 +907,10 @@ namespace xmreg
 
                 wdbi.put(wtxn, payment_id_val, tx_hash_val);
 
+                add_to_filter("encrypted_payments_id",
+                              payment_id_str.data(), payment_id_str.size());
+                sync_filter("encrypted_payments_id", wtxn, synced_filters);
+
                 wtxn.commit();
             }
             catch (lmdb::error& e)
@@ -342,32 +922,700 @@ namespace xmreg
             return true;
         }
 
-        bool
-        search(const string& key,
-               vector<string>& found_tx_hashes,
-               const string& db_name = "key_images")
+        /**
+         * Key index entries of a block and its txs,
+         * including its coinbase tx.
+         */
+        static vector<pair<crypto::hash, key_index_entry>>
+        get_key_index_items(const block& blk,
+                            uint64_t blk_height,
+                            const vector<transaction>& txs)
         {
-            unsigned int flags = MDB_DUPSORT | MDB_DUPFIXED;
+            vector<pair<crypto::hash, key_index_entry>> items;
 
-            try
+            items.push_back({get_block_hash(blk),
+                             key_index_entry {KEY_BLOCK_HASH, null_hash, blk_height}});
+
+            vector<const transaction*> all_txs {&blk.miner_tx};
+
+            for (const transaction& tx: txs)
             {
+                all_txs.push_back(&tx);
+            }
 
-                lmdb::txn rtxn  = lmdb::txn::begin(m_env, nullptr, MDB_RDONLY);
-                lmdb::dbi rdbi  = lmdb::dbi::open(rtxn, db_name.c_str(), flags);
-                lmdb::cursor cr = lmdb::cursor::open(rtxn, rdbi);
+            for (const transaction* tx: all_txs)
+            {
+                crypto::hash tx_hash = get_transaction_hash(*tx);
 
-                lmdb::val key_to_find{key};
-                lmdb::val tx_hash_val;
+                auto add = [&](const crypto::hash& key, key_kind kind)
+                {
+                    items.push_back({key, key_index_entry {kind, tx_hash, blk_height}});
+                };
 
-                // set cursor the the first item
-                if (cr.get(key_to_find, tx_hash_val, MDB_SET))
+                add(tx_hash, KEY_TX_HASH);
+
+                for (const cryptonote::txin_to_key& in: xmreg::get_key_images(*tx))
                 {
-                    //cout << key_val_to_str(key_to_find, tx_hash_val) << endl;
-                    found_tx_hashes.push_back(string(tx_hash_val.data(), tx_hash_val.size()));
+                    add(to_index_key(in.k_image), KEY_KEY_IMAGE);
+                }
 
-                    // process other values for the same key
-                    while (cr.get(key_to_find, tx_hash_val, MDB_NEXT_DUP))
-                    {
+                add(to_index_key(get_tx_pub_key_from_extra(*tx)), KEY_TX_PUB_KEY);
+
+                crypto::hash  payment_id;
+                crypto::hash8 payment_id8;
+
+                get_payment_id(*tx, payment_id, payment_id8);
+
+                if (payment_id != null_hash)
+                {
+                    add(payment_id, KEY_PAYMENT_ID);
+                }
+
+                if (payment_id8 != null_hash8)
+                {
+                    add(to_index_key(payment_id8), KEY_ENCRYPTED_PAYMENT_ID);
+                }
+
+                for (const auto& output: xmreg::get_ouputs_tuple(*tx))
+                {
+                    add(to_index_key(std::get<0>(output).key), KEY_OUTPUT_PUB_KEY);
+                }
+            }
+
+            return items;
+        }
+
+        /**
+         * Find what a given 32 byte value is.
+         *
+         * Returns false if its not in the key index.
+         */
+        bool
+        get_key_index(const crypto::hash& key,
+                      vector<key_index_entry>& entries)
+        {
+            try
+            {
+                read_session session {*this};
+
+                if (!might_contain("key_index", &key, sizeof(key), session.txn()))
+                {
+                    return false;
+                }
+
+                lmdb::cursor& cr = session.cursor("key_index");
+
+                lmdb::val key_val {static_cast<const void*>(&key), sizeof(key)};
+                lmdb::val entry_val;
+
+                if (!cr.get(key_val, entry_val, MDB_SET))
+                {
+                    return false;
+                }
+
+                entries.push_back(*(entry_val.data<key_index_entry>()));
+
+                while (cr.get(key_val, entry_val, MDB_NEXT_DUP))
+                {
+                    entries.push_back(*(entry_val.data<key_index_entry>()));
+                }
+            }
+            catch (lmdb::error& e)
+            {
+                cerr << e.what() << endl;
+                return false;
+            }
+
+            return true;
+        }
+
+        /**
+         * Find entries of the key index whose keys start with
+         * a given hex prefix, e.g., first 16 characters of a tx hash.
+         *
+         * Keys are sorted, so the cursor is set at the first key not
+         * lower than the prefix and moved forward only while keys
+         * match it. Entries before offset are skipped, at most limit
+         * are returned, and has_more is set if there are more of them.
+         */
+        bool
+        search_key_index_prefix(const string& hex_prefix,
+                                size_t offset,
+                                size_t limit,
+                                vector<pair<crypto::hash, key_index_entry>>& found,
+                                bool& has_more)
+        {
+            has_more = false;
+
+            if (hex_prefix.empty() || hex_prefix.size() > sizeof(crypto::hash) * 2)
+            {
+                return false;
+            }
+
+            // lowest key with the prefix, i.e., prefix followed by zeros.
+            // For odd number of hex characters, the last
+            // byte has only its high nibble given.
+            crypto::hash lowest_key = null_hash;
+
+            unsigned char* lowest_bytes = reinterpret_cast<unsigned char*>(&lowest_key);
+
+            for (size_t i = 0; i < hex_prefix.size(); ++i)
+            {
+                int nibble = hex_char_to_int(hex_prefix[i]);
+
+                if (nibble < 0)
+                {
+                    return false;
+                }
+
+                lowest_bytes[i / 2] |= (i % 2 == 0) ? (nibble << 4) : nibble;
+            }
+
+            size_t full_bytes = hex_prefix.size() / 2;
+            bool   half_byte  = hex_prefix.size() % 2 == 1;
+
+            auto has_prefix = [&](const lmdb::val& key_val)
+            {
+                if (key_val.size() != sizeof(crypto::hash))
+                {
+                    return false;
+                }
+
+                const unsigned char* key_bytes
+                        = reinterpret_cast<const unsigned char*>(key_val.data());
+
+                if (memcmp(key_bytes, lowest_bytes, full_bytes) != 0)
+                {
+                    return false;
+                }
+
+                return !half_byte
+                       || (key_bytes[full_bytes] & 0xf0) == lowest_bytes[full_bytes];
+            };
+
+            try
+            {
+                read_session session {*this};
+
+                lmdb::cursor& cr = session.cursor("key_index");
+
+                lmdb::val key_val {static_cast<const void*>(&lowest_key),
+                                   sizeof(lowest_key)};
+                lmdb::val entry_val;
+
+                if (!cr.get(key_val, entry_val, MDB_SET_RANGE))
+                {
+                    return true;
+                }
+
+                size_t entry_i {0};
+
+                do
+                {
+                    if (!has_prefix(key_val))
+                    {
+                        break;
+                    }
+
+                    if (entry_i >= offset + limit)
+                    {
+                        has_more = true;
+                        break;
+                    }
+
+                    if (entry_i >= offset)
+                    {
+                        found.push_back({*(key_val.data<crypto::hash>()),
+                                         *(entry_val.data<key_index_entry>())});
+                    }
+
+                    ++entry_i;
+                }
+                while (cr.get(key_val, entry_val, MDB_NEXT));
+            }
+            catch (lmdb::error& e)
+            {
+                cerr << e.what() << endl;
+                return false;
+            }
+
+            return true;
+        }
+
+        /**
+         * All records written to the tables for a given block and its
+         * txs, including its coinbase tx. These are the same records
+         * as written by write_key_images, write_output_public_keys,
+         * write_tx_public_key, write_payment_id and
+         * write_encrypted_payment_id, and entries of the key index.
+         */
+        static vector<db_record>
+        get_block_records(const block& blk,
+                          uint64_t blk_height,
+                          const vector<transaction>& txs)
+        {
+            vector<db_record> records;
+
+            auto pod_to_str = [](const auto& pod)
+            {
+                return string(reinterpret_cast<const char*>(&pod), sizeof(pod));
+            };
+
+            string blk_height_str    = pod_to_str(blk_height);
+            uint64_t blk_timestamp   = blk.timestamp;
+            string blk_timestamp_str = pod_to_str(blk_timestamp);
+
+            records.push_back({"block_timestamps", blk_height_str, blk_timestamp_str});
+
+            vector<const transaction*> all_txs {&blk.miner_tx};
+
+            for (const transaction& tx: txs)
+            {
+                all_txs.push_back(&tx);
+            }
+
+            for (const transaction* tx: all_txs)
+            {
+                crypto::hash tx_hash = get_transaction_hash(*tx);
+
+                string tx_hash_str = pod_to_hex(tx_hash);
+
+                for (const cryptonote::txin_to_key& in: xmreg::get_key_images(*tx))
+                {
+                    records.push_back({"key_images", pod_to_hex(in.k_image), tx_hash_str});
+                }
+
+                crypto::public_key tx_pub_key = get_tx_pub_key_from_extra(*tx);
+
+                for (const auto& output: xmreg::get_ouputs_tuple(*tx))
+                {
+                    public_key out_pub_key = std::get<0>(output).key;
+
+                    string public_key_str = pod_to_hex(out_pub_key);
+
+                    uint64_t amount      = std::get<1>(output);
+                    uint64_t index_in_tx = std::get<2>(output);
+
+                    output_info out_info {out_pub_key, tx_hash, tx_pub_key,
+                                          amount, index_in_tx};
+
+                    records.push_back({"output_public_keys", public_key_str, tx_hash_str});
+                    records.push_back({"output_amounts", public_key_str, pod_to_str(amount)});
+                    records.push_back({"output_info", blk_timestamp_str, pod_to_str(out_info)});
+                    records.push_back({"output_info_by_height", blk_height_str, pod_to_str(out_info)});
+                }
+
+                records.push_back({"tx_public_keys", pod_to_hex(tx_pub_key), tx_hash_str});
+
+                crypto::hash  payment_id;
+                crypto::hash8 payment_id8;
+
+                get_payment_id(*tx, payment_id, payment_id8);
+
+                if (payment_id != null_hash)
+                {
+                    records.push_back({"payments_id", pod_to_hex(payment_id), tx_hash_str});
+                }
+
+                if (payment_id8 != null_hash8)
+                {
+                    records.push_back({"encrypted_payments_id", pod_to_hex(payment_id8), tx_hash_str});
+                }
+            }
+
+            for (const auto& item: get_key_index_items(blk, blk_height, txs))
+            {
+                records.push_back({"key_index", pod_to_str(item.first), pod_to_str(item.second)});
+            }
+
+            return records;
+        }
+
+        /**
+         * Write all records of a block in one write txn, and mark the
+         * block as indexed. Records are also kept in "indexed_blocks",
+         * so that they can be removed if the block is reorganized away.
+         */
+        bool
+        index_block(const block& blk,
+                    uint64_t blk_height,
+                    const vector<transaction>& txs)
+        {
+            vector<db_record> records = get_block_records(blk, blk_height, txs);
+
+            try
+            {
+                lmdb::txn wtxn = lmdb::txn::begin(m_env);
+
+                put_records(wtxn, records);
+
+                crypto::hash blk_hash = get_block_hash(blk);
+
+                string undo_record(reinterpret_cast<const char*>(&blk_hash),
+                                   sizeof(blk_hash));
+
+                undo_record += serialize_records(records);
+
+                lmdb::dbi wdbi {get_dbi("indexed_blocks")};
+
+                lmdb::val height_val {static_cast<void*>(&blk_height), sizeof(blk_height)};
+                lmdb::val undo_val   {undo_record};
+
+                wdbi.put(wtxn, height_val, undo_val);
+
+                // records of blocks deep enough are not needed
+                if (blk_height >= MAX_UNDO_DEPTH)
+                {
+                    uint64_t old_height = blk_height - MAX_UNDO_DEPTH;
+
+                    lmdb::val old_height_val {static_cast<void*>(&old_height),
+                                              sizeof(old_height)};
+
+                    wdbi.del(wtxn, old_height_val);
+                }
+
+                put_indexed_height(wtxn, blk_height + 1);
+
+                wtxn.commit();
+            }
+            catch (lmdb::error& e)
+            {
+                cerr << e.what() << endl;
+                return false;
+            }
+
+            return true;
+        }
+
+        /**
+         * Write records of many consecutive blocks, starting from
+         * first_height, in one write txn.
+         *
+         * Records are sorted per table before writing, so the pages
+         * of each table are filled in key order. Tables keyed by
+         * height only grow at their end, so for them records are
+         * appended with MDB_APPEND/MDB_APPENDDUP, without searching
+         * the tree. Tables keyed by hashes are written in sorted order
+         * too, but not appended, as their keys are spread over the
+         * whole table, not only after keys of earlier batches.
+         *
+         * Like index_block, records of the last MAX_UNDO_DEPTH
+         * blocks are kept in "indexed_blocks".
+         */
+        bool
+        index_blocks_in_bulk(uint64_t first_height,
+                             const vector<vector<db_record>>& blocks_records,
+                             const vector<crypto::hash>& blk_hashes)
+        {
+            if (blocks_records.empty())
+            {
+                return true;
+            }
+
+            uint64_t last_height = first_height + blocks_records.size() - 1;
+
+            map<string, vector<const db_record*>> tables_records;
+
+            for (const vector<db_record>& records: blocks_records)
+            {
+                for (const db_record& record: records)
+                {
+                    tables_records[record.table].push_back(&record);
+                }
+            }
+
+            try
+            {
+                lmdb::txn wtxn = lmdb::txn::begin(m_env);
+
+                set<string> synced_filters = get_synced_filters(wtxn);
+
+                for (auto& table_records: tables_records)
+                {
+                    const string& table = table_records.first;
+
+                    vector<const db_record*>& records = table_records.second;
+
+                    bool integer_key = is_integer_key_table(table);
+
+                    std::sort(records.begin(), records.end(),
+                              [&](const db_record* a, const db_record* b)
+                              {
+                                  if (integer_key && a->key != b->key)
+                                  {
+                                      return key_to_uint64(a->key) < key_to_uint64(b->key);
+                                  }
+
+                                  return std::tie(a->key, a->value)
+                                         < std::tie(b->key, b->value);
+                              });
+
+                    unsigned int append_flags {0};
+
+                    if (table == "block_timestamps")
+                    {
+                        append_flags = MDB_APPEND;
+                    }
+                    else if (table == "output_info_by_height")
+                    {
+                        append_flags = MDB_APPEND | MDB_APPENDDUP;
+                    }
+
+                    lmdb::dbi wdbi {get_dbi(table)};
+
+                    for (const db_record* record: records)
+                    {
+                        lmdb::val key_val   {record->key};
+                        lmdb::val value_val {record->value};
+
+                        // append fails if the table already has
+                        // higher keys, e.g., when a range of blocks
+                        // is indexed again. Then just put the record.
+                        if (!wdbi.put(wtxn, key_val, value_val, append_flags)
+                            && append_flags != 0)
+                        {
+                            wdbi.put(wtxn, key_val, value_val);
+                        }
+
+                        add_to_filter(table, record->key.data(), record->key.size());
+                    }
+
+                    sync_filter(table, wtxn, synced_filters);
+                }
+
+                lmdb::dbi wdbi {get_dbi("indexed_blocks")};
+
+                // records are kept for blocks from keep_from
+                uint64_t keep_from = last_height + 1 > MAX_UNDO_DEPTH
+                                     ? last_height + 1 - MAX_UNDO_DEPTH : 0;
+
+                uint64_t undo_start = std::max(first_height, keep_from);
+
+                for (uint64_t blk_height = undo_start; blk_height <= last_height; ++blk_height)
+                {
+                    uint64_t i = blk_height - first_height;
+
+                    string undo_record(reinterpret_cast<const char*>(&blk_hashes[i]),
+                                       sizeof(blk_hashes[i]));
+
+                    undo_record += serialize_records(blocks_records[i]);
+
+                    lmdb::val height_val {static_cast<void*>(&blk_height), sizeof(blk_height)};
+                    lmdb::val undo_val   {undo_record};
+
+                    wdbi.put(wtxn, height_val, undo_val);
+                }
+
+                // remove records of earlier blocks that are now too deep
+                uint64_t old_height = first_height > MAX_UNDO_DEPTH
+                                      ? first_height - MAX_UNDO_DEPTH : 0;
+
+                for (; old_height < keep_from && old_height < first_height; ++old_height)
+                {
+                    wdbi.del(wtxn, old_height);
+                }
+
+                put_indexed_height(wtxn, last_height + 1);
+
+                wtxn.commit();
+            }
+            catch (lmdb::error& e)
+            {
+                cerr << e.what() << endl;
+                return false;
+            }
+
+            return true;
+        }
+
+        /**
+         * Remove records of the last indexed block, e.g., after
+         * it was reorganized away from the blockchain.
+         */
+        bool
+        unindex_last_block()
+        {
+            try
+            {
+                lmdb::txn wtxn = lmdb::txn::begin(m_env);
+
+                set<string> synced_filters = get_synced_filters(wtxn);
+
+                lmdb::dbi wdbi {get_dbi("indexed_blocks")};
+
+                lmdb::cursor cr = lmdb::cursor::open(wtxn, wdbi);
+
+                lmdb::val height_val;
+                lmdb::val undo_val;
+
+                if (!cr.get(height_val, undo_val, MDB_LAST))
+                {
+                    return false;
+                }
+
+                uint64_t blk_height = *(height_val.data<uint64_t>());
+
+                if (undo_val.size() < sizeof(crypto::hash))
+                {
+                    cerr << "Broken undo record of block " << blk_height << endl;
+                    return false;
+                }
+
+                vector<db_record> records;
+
+                if (!deserialize_records(string(undo_val.data() + sizeof(crypto::hash),
+                                                undo_val.size() - sizeof(crypto::hash)),
+                                         records))
+                {
+                    cerr << "Broken undo record of block " << blk_height << endl;
+                    return false;
+                }
+
+                for (const db_record& record: records)
+                {
+                    lmdb::dbi rdbi {get_dbi(record.table)};
+
+                    lmdb::val key_val   {record.key};
+                    lmdb::val value_val {record.value};
+
+                    lmdb::dbi_del(wtxn, rdbi.handle(), key_val, value_val);
+                }
+
+                cr.close();
+
+                wdbi.del(wtxn, blk_height);
+
+                put_indexed_height(wtxn, blk_height);
+
+                // filters cant remove keys, but they still
+                // have all keys of their tables
+                for (const string& table: synced_filters)
+                {
+                    sync_filter(table, wtxn, synced_filters);
+                }
+
+                wtxn.commit();
+            }
+            catch (lmdb::error& e)
+            {
+                cerr << e.what() << endl;
+                return false;
+            }
+
+            return true;
+        }
+
+        /**
+         * Height and hash of the last block whose records are
+         * kept in "indexed_blocks", i.e., the last block that
+         * can be removed by unindex_last_block.
+         *
+         * found is false if there is no such block. Returns
+         * false if the table cant be read.
+         */
+        bool
+        get_last_indexed_block(uint64_t& blk_height, crypto::hash& blk_hash,
+                               bool& found)
+        {
+            found = false;
+
+            try
+            {
+                read_session session {*this};
+
+                lmdb::cursor& cr = session.cursor("indexed_blocks");
+
+                lmdb::val height_val;
+                lmdb::val undo_val;
+
+                if (!cr.get(height_val, undo_val, MDB_LAST))
+                {
+                    return true;
+                }
+
+                blk_height = *(height_val.data<uint64_t>());
+                blk_hash   = *(undo_val.data<crypto::hash>());
+
+                found = true;
+            }
+            catch (lmdb::error& e)
+            {
+                cerr << e.what() << endl;
+                return false;
+            }
+
+            return true;
+        }
+
+        /**
+         * Number of blocks indexed by index_block and
+         * index_blocks_in_bulk, i.e., height of the next
+         * block to index. Its kept in "indexer_state" and
+         * changed in the same txn as the indexed records.
+         *
+         * found is false if no block was ever indexed. Returns
+         * false if the table cant be read.
+         */
+        bool
+        get_indexed_height(uint64_t& indexed_height, bool& found)
+        {
+            found = false;
+
+            try
+            {
+                read_session session {*this};
+
+                lmdb::dbi rdbi = session.dbi("indexer_state");
+
+                lmdb::val key_val {INDEXED_HEIGHT_KEY};
+                lmdb::val height_val;
+
+                if (!rdbi.get(session.txn(), key_val, height_val))
+                {
+                    return true;
+                }
+
+                indexed_height = *(height_val.data<uint64_t>());
+
+                found = true;
+            }
+            catch (lmdb::error& e)
+            {
+                cerr << e.what() << endl;
+                return false;
+            }
+
+            return true;
+        }
+
+        bool
+        search(const string& key,
+               vector<string>& found_tx_hashes,
+               const string& db_name = "key_images")
+        {
+            try
+            {
+                read_session session {*this};
+
+                if (!might_contain(db_name, key.data(), key.size(), session.txn()))
+                {
+                    return false;
+                }
+
+                lmdb::cursor& cr = session.cursor(db_name);
+
+                lmdb::val key_to_find{key};
+                lmdb::val tx_hash_val;
+
+                // set cursor the the first item
+                if (cr.get(key_to_find, tx_hash_val, MDB_SET))
+                {
+                    //cout << key_val_to_str(key_to_find, tx_hash_val) << endl;
+                    found_tx_hashes.push_back(string(tx_hash_val.data(), tx_hash_val.size()));
+
+                    // process other values for the same key
+                    while (cr.get(key_to_find, tx_hash_val, MDB_NEXT_DUP))
+                    {
                         //cout << key_val_to_str(key_to_find, tx_hash_val) << endl;
                         found_tx_hashes.push_back(string(tx_hash_val.data(), tx_hash_val.size()));
                     }
@@ -376,10 +1624,6 @@ namespace xmreg
                 {
                     return false;
                 }
-
-                cr.close();
-                rtxn.abort();
-
             }
             catch (lmdb::error& e)
             {
@@ -395,27 +1639,21 @@ namespace xmreg
                           uint64_t& amount,
                           const string& db_name = "output_amounts")
         {
-
-            unsigned int flags = 0;
-
             try
             {
+                read_session session {*this};
 
-                lmdb::txn rtxn  = lmdb::txn::begin(m_env, nullptr, MDB_RDONLY);
-                lmdb::dbi rdbi  = lmdb::dbi::open(rtxn, db_name.c_str(), flags);
+                lmdb::dbi rdbi  = session.dbi(db_name);
 
                 lmdb::val key_to_find{key};
                 lmdb::val amount_val;
 
-                if(!rdbi.get(rtxn, key_to_find, amount_val))
+                if(!rdbi.get(session.txn(), key_to_find, amount_val))
                 {
                     return false;
                 }
 
                 amount = *(amount_val.data<uint64_t>());
-
-                rtxn.abort();
-
             }
             catch (lmdb::error& e)
             {
@@ -432,24 +1670,16 @@ namespace xmreg
                         vector<output_info>& out_infos,
                         const string& db_name = "output_info")
         {
-
-            unsigned int flags = 0;
-
             try
             {
+                read_session session {*this};
 
-                lmdb::txn rtxn  = lmdb::txn::begin(m_env, nullptr, MDB_RDONLY);
-                lmdb::dbi rdbi  = lmdb::dbi::open(rtxn, db_name.c_str(), flags);
+                lmdb::cursor& cr = session.cursor(db_name);
 
                 lmdb::val key_to_find{static_cast<void*>(&key_timestamp),
                                       sizeof(key_timestamp)};
                 lmdb::val info_val;
 
-
-
-                lmdb::cursor cr = lmdb::cursor::open(rtxn, rdbi);
-
-
                 // set cursor the the first item
                 if (cr.get(key_to_find, info_val, MDB_SET))
                 {
@@ -466,11 +1696,173 @@ namespace xmreg
                 {
                     return false;
                 }
+            }
+            catch (lmdb::error& e)
+            {
+                cerr << e.what() << endl;
+                return false;
+            }
 
-                cr.close();
+            return true;
+        }
 
-                rtxn.abort();
+        /**
+         * Go through output_info of all blocks from h0 to h1 (inclusive)
+         * using single read transaction and cursor. For each block
+         * found, f is called with its height, timestamp and
+         * all its output_info. Iteration stops if f returns false.
+         */
+        bool
+        get_output_info_range(
+                uint64_t h0, uint64_t h1,
+                std::function<bool(uint64_t blk_height,
+                                   uint64_t blk_timestamp,
+                                   vector<output_info>& out_infos)> f)
+        {
+            try
+            {
+                read_session session {*this};
+
+                lmdb::cursor& cr = session.cursor("output_info_by_height");
+                lmdb::dbi rdbi   = session.dbi("block_timestamps");
+
+                uint64_t blk_height = h0;
+
+                lmdb::val height_val {static_cast<void*>(&blk_height),
+                                      sizeof(blk_height)};
+                lmdb::val info_val;
+
+                // set cursor to the first block at or above h0
+                if (!cr.get(height_val, info_val, MDB_SET_RANGE))
+                {
+                    return true;
+                }
+
+                while (true)
+                {
+                    blk_height = *(height_val.data<uint64_t>());
+
+                    if (blk_height > h1)
+                    {
+                        break;
+                    }
+
+                    vector<output_info> out_infos;
+
+                    out_infos.push_back(*(info_val.data<output_info>()));
+
+                    // process other values for the same block
+                    while (cr.get(height_val, info_val, MDB_NEXT_DUP))
+                    {
+                        out_infos.push_back(*(info_val.data<output_info>()));
+                    }
+
+                    uint64_t blk_timestamp {0};
+
+                    rdbi.get(session.txn(), blk_height, blk_timestamp);
+
+                    if (f(blk_height, blk_timestamp, out_infos) == false)
+                    {
+                        break;
+                    }
+
+                    // move to the next block
+                    if (!cr.get(height_val, info_val, MDB_NEXT_NODUP))
+                    {
+                        break;
+                    }
+                }
+            }
+            catch (lmdb::error& e)
+            {
+                cerr << e.what() << endl;
+                return false;
+            }
+
+            return true;
+        }
+
+        /**
+         * Height of the last block in "output_info_by_height".
+         * False if there are no blocks in it, e.g., for lmdb2
+         * made before the table was added.
+         */
+        bool
+        get_last_output_info_height(uint64_t& blk_height)
+        {
+            try
+            {
+                read_session session {*this};
 
+                lmdb::cursor& cr = session.cursor("output_info_by_height");
+
+                lmdb::val height_val;
+                lmdb::val info_val;
+
+                if (!cr.get(height_val, info_val, MDB_LAST))
+                {
+                    return false;
+                }
+
+                blk_height = *(height_val.data<uint64_t>());
+            }
+            catch (lmdb::error& e)
+            {
+                cerr << e.what() << endl;
+                return false;
+            }
+
+            return true;
+        }
+
+
+        /**
+         * Save a checkpoint of outputs search under a given key,
+         * replacing previous checkpoint of the key, if any.
+         * The checkpoint is an opaque blob, encrypted by the caller.
+         */
+        bool
+        write_scan_checkpoint(const string& key, const string& blob)
+        {
+            try
+            {
+                lmdb::txn wtxn = lmdb::txn::begin(m_env);
+                lmdb::dbi wdbi {get_dbi("scan_checkpoints")};
+
+                lmdb::val key_val  {key};
+                lmdb::val blob_val {blob};
+
+                wdbi.put(wtxn, key_val, blob_val);
+
+                wtxn.commit();
+            }
+            catch (lmdb::error& e)
+            {
+                cerr << e.what() << endl;
+                return false;
+            }
+
+            return true;
+        }
+
+        bool
+        get_scan_checkpoint(const string& key, string& blob)
+        {
+            try
+            {
+                read_session session {*this};
+
+                lmdb::dbi rdbi = session.dbi("scan_checkpoints");
+
+                lmdb::val key_val {key};
+                lmdb::val blob_val;
+
+                if (!rdbi.get(session.txn(), key_val, blob_val))
+                {
+                    return false;
+                }
+
+                blob = string(blob_val.data(), blob_val.size());
             }
             catch (lmdb::error& e)
             {
@@ -487,14 +1879,11 @@ namespace xmreg
                 std::function<bool(public_key& out_pubkey,
                                    output_info& out_info)> f)
         {
-            unsigned int flags = MDB_DUPSORT | MDB_DUPFIXED;
-
             try
             {
+                read_session session {*this};
 
-                lmdb::txn rtxn  = lmdb::txn::begin(m_env, nullptr, MDB_RDONLY);
-                lmdb::dbi rdbi  = lmdb::dbi::open(rtxn, "output_info", flags);
-                lmdb::cursor cr = lmdb::cursor::open(rtxn, rdbi);
+                lmdb::cursor& cr = session.cursor("output_info");
 
                 lmdb::val key_to_find;
                 lmdb::val amount_val;
@@ -515,10 +1904,6 @@ namespace xmreg
                         break;
                     }
                 }
-
-                cr.close();
-                rtxn.abort();
-
             }
             catch (lmdb::error& e)
             {
@@ -530,14 +1915,11 @@ namespace xmreg
         void
         print_all(const string& db_name)
         {
-            unsigned int flags = MDB_DUPSORT | MDB_DUPFIXED;
-
             try
             {
+                read_session session {*this};
 
-                lmdb::txn rtxn  = lmdb::txn::begin(m_env, nullptr, MDB_RDONLY);
-                lmdb::dbi rdbi  = lmdb::dbi::open(rtxn, db_name.c_str(), flags);
-                lmdb::cursor cr = lmdb::cursor::open(rtxn, rdbi);
+                lmdb::cursor& cr = session.cursor(db_name);
 
                 lmdb::val key_to_find;
                 lmdb::val tx_hash_val;
@@ -548,10 +1930,6 @@ namespace xmreg
                 {
                     cout << key_val_to_str(key_to_find, tx_hash_val) << endl;
                 }
-
-                cr.close();
-                rtxn.abort();
-
             }
             catch (lmdb::error& e)
             {
@@ -598,6 +1976,150 @@ namespace xmreg
 
         }
 
+        void
+        put_indexed_height(lmdb::txn& wtxn, uint64_t indexed_height)
+        {
+            lmdb::dbi wdbi {get_dbi("indexer_state")};
+
+            lmdb::val key_val    {INDEXED_HEIGHT_KEY};
+            lmdb::val height_val {static_cast<void*>(&indexed_height),
+                                  sizeof(indexed_height)};
+
+            wdbi.put(wtxn, key_val, height_val);
+        }
+
+        /**
+         * Write records in a given write txn, adding
+         * their keys to the tables' filters. Must be
+         * the first write in the txn.
+         */
+        void
+        put_records(lmdb::txn& wtxn, const vector<db_record>& records)
+        {
+            set<string> synced_filters = get_synced_filters(wtxn);
+
+            set<string> tables;
+
+            for (const db_record& record: records)
+            {
+                lmdb::dbi wdbi {get_dbi(record.table)};
+
+                lmdb::val key_val   {record.key};
+                lmdb::val value_val {record.value};
+
+                wdbi.put(wtxn, key_val, value_val);
+
+                add_to_filter(record.table, record.key.data(), record.key.size());
+
+                tables.insert(record.table);
+            }
+
+            for (const string& table: tables)
+            {
+                sync_filter(table, wtxn, synced_filters);
+            }
+        }
+
+        static bool
+        is_integer_key_table(const string& table)
+        {
+            return table == "block_timestamps"
+                   || table == "output_info"
+                   || table == "output_info_by_height"
+                   || table == "indexed_blocks";
+        }
+
+        static uint64_t
+        key_to_uint64(const string& key)
+        {
+            uint64_t value {0};
+
+            memcpy(&value, key.data(), std::min(key.size(), sizeof(value)));
+
+            return value;
+        }
+
+        /**
+         * Records as: table, key, value, each
+         * preceded by its size as uint32_t.
+         */
+        static string
+        serialize_records(const vector<db_record>& records)
+        {
+            string out;
+
+            auto append = [&](const string& str)
+            {
+                uint32_t size = static_cast<uint32_t>(str.size());
+                out.append(reinterpret_cast<const char*>(&size), sizeof(size));
+                out.append(str);
+            };
+
+            for (const db_record& record: records)
+            {
+                append(record.table);
+                append(record.key);
+                append(record.value);
+            }
+
+            return out;
+        }
+
+        static bool
+        deserialize_records(const string& in, vector<db_record>& records)
+        {
+            size_t pos {0};
+
+            auto read_str = [&](string& str)
+            {
+                uint32_t size;
+
+                if (in.size() - pos < sizeof(size))
+                {
+                    return false;
+                }
+
+                memcpy(&size, in.data() + pos, sizeof(size));
+                pos += sizeof(size);
+
+                if (in.size() - pos < size)
+                {
+                    return false;
+                }
+
+                str = in.substr(pos, size);
+                pos += size;
+
+                return true;
+            };
+
+            while (pos < in.size())
+            {
+                db_record record;
+
+                if (!read_str(record.table)
+                    || !read_str(record.key)
+                    || !read_str(record.value))
+                {
+                    return false;
+                }
+
+                records.push_back(std::move(record));
+            }
+
+            return true;
+        }
+
+        static int
+        hex_char_to_int(char c)
+        {
+            if (c >= '0' && c <= '9') return c - '0';
+            if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+            if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+
+            return -1;
+        }
+
         string
         key_val_to_str(const lmdb::val& key, const lmdb::val& val)
         {
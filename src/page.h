@@ -27,11 +27,25 @@
 #include "tools.h"
 #include "rpccalls.h"
 #include "mylmdb.h"
+#include "lru_cache.h"
+#include "TemplateRegistry.h"
+#include "thread_pool.h"
+
+#include "crypto/chacha8.h"
 
 #include <algorithm>
 #include <limits>
 #include <ctime>
 #include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <unordered_map>
+#include <unordered_set>
+#include <future>
+#include <condition_variable>
+#include <deque>
+#include <set>
 
 #define TMPL_DIR             "./templates"
 #define TMPL_PARIALS_DIR     TMPL_DIR "/partials"
@@ -46,6 +60,7 @@
 #define TMPL_MY_OUTPUTS      TMPL_DIR "/my_outputs.html"
 #define TMPL_MY_TX_OUTPUTS   TMPL_DIR "/my_tx_outputs.html"
 #define TMPL_SEARCH_RESULTS  TMPL_DIR "/search_results.html"
+#define TMPL_SEARCH_PREFIX   TMPL_DIR "/search_prefix_results.html"
 #define TMPL_REDIRECT        TMPL_DIR "/redirect_to_status.html"
 
 namespace xmreg {
@@ -199,38 +214,146 @@ namespace xmreg {
     };
 
 
+    /**
+     * @brief The tx_summary struct
+     *
+     * Only the numbers shown for mixins' txs. Much cheaper
+     * to get than full tx_details.
+     */
+    struct tx_summary
+    {
+        uint64_t mixin_no   {0};
+        uint64_t no_inputs  {0}; // number of txin_to_key inputs
+        uint64_t no_outputs {0}; // number of txout_to_key outputs
+    };
+
+
     struct search_class_test
     {
-        static xmreg::MyLMDB mylmdb ;
+
+        // number of blocks scanned as one unit of work
+        // by a single worker thread
+        static const uint64_t NO_OF_BLOCKS_PER_CHUNK {200};
+
+        // number of blocks below the last checkpointed height that
+        // are scanned again, in case they were changed by a reorg
+        static const uint64_t CHECKPOINT_OVERLAP {10};
+
+        // first field of a checkpoint, to check if it was
+        // decrypted correctly
+        static const uint64_t CHECKPOINT_MAGIC {0x31746b6372786d78}; // "xmrckpt1"
+
+        /**
+         * Output found in a chunk of blocks, kept
+         * until all earlier chunks are finished, so that
+         * outputs can be reported in height order.
+         */
+        struct found_output
+        {
+            output_info out_info;
+            uint64_t    blk_timestamp;
+            uint64_t    blk_height;
+        };
+
+        /**
+         * Start of a saved checkpoint. It is followed
+         * by no_of_outputs found_output structures.
+         */
+        struct checkpoint_header
+        {
+            uint64_t magic;
+            uint64_t scan_start;     // first block scanned
+            uint64_t last_height;    // last block scanned
+            uint64_t last_timestamp; // timestamp of the last block
+            uint64_t no_of_outputs;
+        };
+
+        struct chunk_result
+        {
+            vector<found_output> found;
+            uint64_t last_height    {0};
+            uint64_t last_timestamp {0};
+            bool     done           {false};
+
+            // key derivations generated for the chunk
+            uint64_t no_of_derivations {0};
+
+            // false if outputs of the chunk could not be read
+            bool     ok             {true};
+        };
 
         MicroCore* mcore;
         Blockchain* core_storage;
 
+        // custom lmdb database shared with the page
+        shared_ptr<xmreg::MyLMDB> mylmdb;
+
         string xmr_address_str ;
         string viewkey_str;
         uint64_t since_when;
 
         uint64_t current_blockchain_height;
 
-        uint64_t block_id;
+        // height up to which all blocks have been scanned
+        std::atomic<uint64_t> block_id;
+
+        std::atomic<bool> user_left;
 
-        bool user_left;
+        std::atomic<bool> search_finished;
 
-        bool search_finished;
+        // when the search was last asked about its status.
+        // Searches not asked about for long are removed.
+        std::atomic<time_t> last_accessed;
 
         string timestamp_str;
 
         mstch::array outputs;
 
+        // guards outputs and timestamp_str, which are
+        // read by the page while the search is running,
+        // and the merging state below
+        std::mutex outputs_mutex;
+
+        // first block to be scanned
+        uint64_t scan_start {0};
+
+        // first block of the range asked for by the user. Lower
+        // than scan_start if outputs were read from a checkpoint.
+        uint64_t requested_start {0};
+
+        // results of scanned chunks not yet merged into outputs
+        vector<chunk_result> chunk_results;
+
+        // index of the first chunk whose outputs were
+        // not yet moved to the outputs array
+        uint64_t next_chunk_to_merge {0};
 
+        // index of the chunk with the last block of the search
+        uint64_t last_chunk_to_merge {0};
 
+        // true if a chunk could not be read. Chunks
+        // after it are not merged.
+        bool scan_failed {false};
 
+        uint64_t out_idx {0};
+
+        crypto::hash previous_tx_hash = null_hash;
+
+        // all outputs found so far, saved in the checkpoint
+        vector<found_output> found_outputs;
+
+        // timestamp of block_id
+        uint64_t last_timestamp {0};
 
         cryptonote::account_public_address address;
         crypto::secret_key prv_view_key;
 
+        // true if both address and viewkey were parsed
+        bool keys_parsed {false};
+
         search_class_test(MicroCore* _mcore,
                           Blockchain* _core_storage,
+                          shared_ptr<xmreg::MyLMDB> _mylmdb,
                           string _xmr_address,
                           string _viewkey,
                           uint64_t _since_when,
@@ -239,13 +362,15 @@ namespace xmreg {
                 :
                   mcore {_mcore},
                   core_storage {_core_storage},
+                  mylmdb {_mylmdb},
                   xmr_address_str {_xmr_address},
                   viewkey_str {_viewkey},
                   since_when {_since_when},
                   current_blockchain_height {_height},
                   block_id{0},
                   user_left {false},
-                  search_finished {false}
+                  search_finished {false},
+                  last_accessed {std::time(nullptr)}
         {
             const set<uint64_t> possible_since_when_values {1, 7, 14, 28};
 
@@ -288,1675 +413,3507 @@ namespace xmreg {
                 return;
             }
 
+            keys_parsed = true;
         };
 
-        void
-        search()
+        /**
+         * Search for outputs of many users in one pass over the blocks.
+         *
+         * The blocks from the earliest start height of all the searches
+         * up to the tip are split into chunks, scanned by a number of
+         * threads. Outputs' info of each block is read from the custom
+         * lmdb database only once, and checked against keys of every
+         * search whose range includes the block. Each search gets its
+         * own results. The chunks are scanned on the scan_pool
+         * threads, shared by all passes.
+         */
+        static void
+        search_together(const vector<search_class_test*>& searches,
+                        thread_pool& scan_pool)
         {
+            // searches that can be run
+            vector<search_class_test*> to_run;
 
-            // rough estimate of number of recent blocks to search
-            // from the current block. Monero blocks now are, on average,
-            // every 120 seconds, so we use this to get the estimate
-            uint64_t no_of_blocks_to_search = since_when*24*3600 / 120;
+            for (search_class_test* search: searches)
+            {
+                if (!search->mylmdb)
+                {
+                    cerr << "Custom lmdb database not available. "
+                         << "Cant search for outputs." << endl;
 
-            uint64_t tx_blk_height {current_blockchain_height - no_of_blocks_to_search};
+                    search->search_finished = true;
+                    continue;
+                }
 
-            uint64_t out_idx = {0};
+                // address, viewkey or since_when were rejected
+                // by the constructor, so there is nothing to scan for
+                if (!search->keys_parsed)
+                {
+                    search->search_finished = true;
+                    continue;
+                }
 
-            uint64_t sum_xmr {0};
+                to_run.push_back(search);
+            }
+
+            if (to_run.empty())
+            {
+                return;
+            }
+
+            // all searches use the same custom lmdb database
+            shared_ptr<xmreg::MyLMDB> mylmdb = to_run.front()->mylmdb;
 
+            // range of blocks to be scanned for all the searches
+            uint64_t scan_start {std::numeric_limits<uint64_t>::max()};
+            uint64_t scan_end   {0};
 
-            for (uint64_t i = tx_blk_height; i <= current_blockchain_height; ++i)
+            for (search_class_test* search: to_run)
             {
+                search->scan_start = search->resume_from_checkpoint(
+                        search->get_start_height());
+
+                scan_start = std::min(scan_start, search->scan_start);
+                scan_end   = std::max(scan_end, search->current_blockchain_height);
+            }
 
-                if (user_left)
-                    return;
+            uint64_t no_of_chunks = scan_end >= scan_start
+                                    ? (scan_end - scan_start) / NO_OF_BLOCKS_PER_CHUNK + 1
+                                    : 0;
 
-                // get block at the given height i
-                block blk;
+            // chunks are scanned starting from these of the search with
+            // the highest start height, up to the tip, then from the
+            // chunks of the search with the next highest start height,
+            // and so on. So a search of recent blocks, e.g., resumed
+            // from a checkpoint, does not wait for longer ones.
+            vector<uint64_t> first_chunks;
 
-                if (!mcore->get_block_by_height(i, blk))
+            for (search_class_test* search: to_run)
+            {
+                // nothing to scan, so finished right away
+                if (search->current_blockchain_height < search->scan_start)
                 {
-                    cerr << "Cant get block: " << i << endl;
+                    search->start_merging(no_of_chunks, 1, 0);
                     continue;
                 }
 
-                crypto::hash block_id;
-
-                vector<output_info> outputs_info;
+                uint64_t first_chunk = (search->scan_start - scan_start)
+                                       / NO_OF_BLOCKS_PER_CHUNK;
 
-                mylmdb.get_output_info(blk.timestamp, outputs_info);
+                uint64_t last_chunk  = (search->current_blockchain_height - scan_start)
+                                       / NO_OF_BLOCKS_PER_CHUNK;
 
+                search->start_merging(no_of_chunks, first_chunk, last_chunk);
 
-                this->block_id = i;
-                this->timestamp_str = xmreg::timestamp_to_str(blk.timestamp);
+                first_chunks.push_back(first_chunk);
+            }
 
-                //cout << "blk: << " << i << " output no.: " << outputs_info.size() << endl;
+            std::sort(first_chunks.begin(), first_chunks.end(), std::greater<uint64_t>());
 
-                //std::this_thread::sleep_for(std::chrono::seconds(1));
+            vector<uint64_t> chunk_order;
 
-                crypto::hash previous_tx_hash = null_hash;
+            uint64_t order_end = no_of_chunks;
 
-                // go through all outputs in each block, based on timestamp,
-                // and search for our outputs
-                for (const xmreg::output_info out_info : outputs_info)
+            for (uint64_t first_chunk: first_chunks)
+            {
+                for (uint64_t chunk_i = first_chunk; chunk_i < order_end; ++chunk_i)
                 {
-                    // public transaction key is combined with our viewkey
-                    // to create, so called, derived key.
-                    crypto::key_derivation derivation;
-
-                    bool r = generate_key_derivation(out_info.tx_pub_key,
-                                                     prv_view_key,
-                                                     derivation);
-
-                    if (!r)
-                    {
-                        cerr << "cant derive key for output: "
-                             << out_info.out_pub_key << endl;
-                        continue;
-                    }
+                    chunk_order.push_back(chunk_i);
+                }
 
-                    // get the tx output public key
-                    // that normally would be generated for us,
-                    // if someone had sent us some xmr.
-                    crypto::public_key generated_pubkey;
+                order_end = std::min(order_end, first_chunk);
+            }
 
-                    derive_public_key(derivation,
-                                      out_info.index_in_tx,
-                                      address.m_spend_public_key,
-                                      generated_pubkey);
+            Blockchain* core_storage = to_run.front()->core_storage;
 
-                    bool same_tx {false};
+            // last block with outputs in output_info_by_height
+            uint64_t by_height_end {0};
 
-                    if (out_info.out_pub_key == generated_pubkey)
-                    {
+            bool has_by_height = mylmdb->get_last_output_info_height(by_height_end);
 
-                        cout << "found output " << endl;
+            // index in chunk_order of the next chunk to be taken by a worker
+            std::atomic<uint64_t> next_chunk {0};
 
-                        sum_xmr += out_info.amount;
+            // each worker takes chunks of blocks one after another
+            // until all chunks are scanned. Finished chunks are
+            // merged into the outputs arrays in height order.
+            auto worker = [&]()
+            {
+                uint64_t order_i;
 
-                        string timestamp_str = xmreg::timestamp_to_str(blk.timestamp);
+                while ((order_i = next_chunk++) < chunk_order.size())
+                {
+                    uint64_t chunk_i = chunk_order[order_i];
 
+                    bool all_left = std::all_of(to_run.begin(), to_run.end(),
+                                                [](search_class_test* search)
+                                                {
+                                                    return search->user_left.load();
+                                                });
+                    if (all_left)
+                        return;
 
-                        same_tx = (previous_tx_hash == out_info.tx_hash);
+                    uint64_t h0 = scan_start + chunk_i * NO_OF_BLOCKS_PER_CHUNK;
+                    uint64_t h1 = std::min(h0 + NO_OF_BLOCKS_PER_CHUNK - 1, scan_end);
 
-                        string out_pub_key_str = REMOVE_HASH_BRAKETS(fmt::format("{:s}",
-                                                                     out_info.out_pub_key));
+                    vector<chunk_result> results(to_run.size());
 
-                        string tx_hash_str      = REMOVE_HASH_BRAKETS(fmt::format("{:s}",
-                                                                      out_info.tx_hash));
+                    auto check_block = [&](uint64_t blk_height,
+                                           uint64_t blk_timestamp,
+                                           vector<output_info>& outputs_info) -> bool
+                    {
+                        bool any_active {false};
 
-                        outputs.push_back(mstch::map {
-                                {"out_pub_key"  , out_pub_key_str},
-                                {"amount"       , out_info.amount},
-                                {"output_idx"   , fmt::format("{:04d}", ++out_idx)},
-                                {"tx_hash"      , tx_hash_str},
-                                {"blk_timestamp", timestamp_str},
-                                {"same_tx"      , !same_tx}
-                        });
+                        for (size_t i = 0; i < to_run.size(); ++i)
+                        {
+                            search_class_test* search = to_run[i];
 
-                        previous_tx_hash = out_info.tx_hash;
+                            if (search->user_left)
+                                continue;
 
-                    }
-                } // for (const xmreg::output_info out_info : outputs_info)
-            } // for (uint64_t i = tx_blk_height;
+                            any_active = true;
 
-            search_finished = true;
+                            if (blk_height < search->scan_start
+                                || blk_height > search->current_blockchain_height)
+                                continue;
 
-        } // search()
+                            results[i].last_height    = blk_height;
+                            results[i].last_timestamp = blk_timestamp;
 
-        ~search_class_test()
-        {
-            cout << "destroy search_class_test" << endl;
-        }
-    };
+                            search->check_block_outputs(blk_height,
+                                                        blk_timestamp,
+                                                        outputs_info,
+                                                        results[i]);
+                        }
 
-    xmreg::MyLMDB search_class_test::mylmdb
-            = xmreg::MyLMDB{"/home/mwo/.bitmonero/lmdb2"};
+                        return any_active;
+                    };
 
+                    bool ok {true};
 
-    class page {
+                    // blocks above by_height_end are not in
+                    // output_info_by_height, so read them by timestamp
+                    if (has_by_height && h0 <= by_height_end)
+                    {
+                        ok = mylmdb->get_output_info_range(
+                                h0, std::min(h1, by_height_end), check_block);
+                    }
 
-        // check if we have tx_blob member in tx_info structure
-        static const bool HAVE_TX_BLOB {
-            HAS_MEMBER(cryptonote::tx_info, tx_blob)
-        };
+                    if (ok && (!has_by_height || h1 > by_height_end))
+                    {
+                        uint64_t first = has_by_height
+                                         ? std::max(h0, by_height_end + 1) : h0;
 
-        static const bool FULL_AGE_FORMAT {true};
+                        ok = get_output_info_by_timestamp(core_storage, mylmdb.get(),
+                                                          first, h1, check_block);
+                    }
 
-        MicroCore* mcore;
-        Blockchain* core_storage;
-        rpccalls rpc;
-        time_t server_timestamp;
+                    for (size_t i = 0; i < to_run.size(); ++i)
+                    {
+                        results[i].ok = ok;
+                        to_run[i]->chunk_done(chunk_i, std::move(results[i]));
+                    }
+                }
+            };
 
-        string lmdb2_path;
+            size_t no_of_tasks = std::min<uint64_t>(scan_pool.size(), chunk_order.size());
 
+            vector<std::future<void>> workers;
 
-        map<string, shared_ptr<xmreg::search_class_test>> searching_threads;
+            for (size_t i = 0; i < no_of_tasks; ++i)
+            {
+                workers.push_back(scan_pool.submit(worker));
+            }
 
+            for (std::future<void>& w: workers)
+            {
+                w.wait();
+            }
 
-    public:
+            if (to_run.size() > 1)
+            {
+                cout << "Scanned blocks " << scan_start << "-" << scan_end
+                     << " for " << to_run.size() << " searches at once" << endl;
+            }
 
-        page(MicroCore* _mcore, Blockchain* _core_storage,
-             string _deamon_url, string _lmdb2_path)
-                : mcore {_mcore},
-                  core_storage {_core_storage},
-                  rpc {_deamon_url},
-                  server_timestamp {std::time(nullptr)},
-                  lmdb2_path {_lmdb2_path}
-        {
+            // searches whose users left, or stopped
+            // when all users left, are not finished yet
+            for (search_class_test* search: to_run)
+            {
+                std::lock_guard<std::mutex> lck (search->outputs_mutex);
 
-        }
+                if (!search->search_finished)
+                {
+                    search->finish_search();
+                }
+            }
 
-        void add_searching_thread(string uuid, shared_ptr<xmreg::search_class_test>& search_cls)
-        {
-            searching_threads[uuid] = search_cls;
-        }
+        } // search_together()
 
         /**
-         * @brief show recent transactions and mempool
-         * @param page_no block page to show
-         * @param refresh_page enable autorefresh
-         * @return rendered index page
+         * Go through outputs of blocks from h0 to h1 (inclusive) as
+         * saved in "output_info" table, i.e., keyed by timestamp of
+         * blocks. Slower than MyLMDB::get_output_info_range, but works
+         * with lmdb2 without outputs by height.
+         *
+         * Outputs of blocks with the same timestamp are saved under one
+         * key, so they are given only with the first of such blocks.
          */
-        string
-        index2(uint64_t page_no = 0, bool refresh_page = false)
+        static bool
+        get_output_info_by_timestamp(
+                Blockchain* core_storage, MyLMDB* mylmdb,
+                uint64_t h0, uint64_t h1,
+                std::function<bool(uint64_t blk_height,
+                                   uint64_t blk_timestamp,
+                                   vector<output_info>& out_infos)> f)
         {
+            try
+            {
+                uint64_t prev_timestamp = h0 > 0
+                        ? core_storage->get_db().get_block_timestamp(h0 - 1)
+                        : 0;
 
-            //get current server timestamp
-            server_timestamp = std::time(nullptr);
+                for (uint64_t blk_height = h0; blk_height <= h1; ++blk_height)
+                {
+                    uint64_t blk_timestamp
+                            = core_storage->get_db().get_block_timestamp(blk_height);
 
-            // get the current blockchain height. Just to check
-            uint64_t height =
-                    xmreg::MyLMDB::get_blockchain_height(mcore->get_blkchain_path()) - 1;
+                    if (blk_timestamp == prev_timestamp)
+                    {
+                        continue;
+                    }
 
-            // initalise page tempate map with basic info about blockchain
-            mstch::map context {
-                    {"refresh"         , refresh_page},
-                    {"height"          , std::to_string(height)},
-                    {"server_timestamp", xmreg::timestamp_to_str(server_timestamp)}
-            };
+                    prev_timestamp = blk_timestamp;
 
-            // read index.html
-            string index2_html = xmreg::read(TMPL_INDEX2);
+                    vector<output_info> out_infos;
 
-            // add header and footer
-            string full_page = get_full_page(index2_html);
+                    if (!mylmdb->get_output_info(blk_timestamp, out_infos))
+                    {
+                        continue;
+                    }
 
-            // render the page
-            return mstch::render(full_page, context);
-        }
+                    if (f(blk_height, blk_timestamp, out_infos) == false)
+                    {
+                        break;
+                    }
+                }
+            }
+            catch (const std::exception& e)
+            {
+                cerr << "Cant read outputs by timestamp: " << e.what() << endl;
+                return false;
+            }
 
+            return true;
+        }
 
         /**
-         * Render mempool data
+         * Height of the first block created since_when days ago
          */
-        string
-        mempool()
+        uint64_t
+        get_start_height()
         {
-            std::vector<tx_info> mempool_txs;
+            // start searching from the first block created
+            // since_when days ago
+            uint64_t since_timestamp = static_cast<uint64_t>(std::time(nullptr))
+                                       - since_when*24*3600;
+
+            uint64_t tx_blk_height {0};
 
-            if (!rpc.get_mempool(mempool_txs))
+            if (!mcore->get_height_by_timestamp(since_timestamp, tx_blk_height))
             {
-              return "Getting mempool failed";
+                // rough estimate of number of recent blocks to search
+                // from the current block. Monero blocks now are, on average,
+                // every 120 seconds, so we use this to get the estimate
+                uint64_t no_of_blocks_to_search = since_when*24*3600 / 120;
+
+                if (current_blockchain_height > no_of_blocks_to_search)
+                {
+                    tx_blk_height = current_blockchain_height - no_of_blocks_to_search;
+                }
             }
 
-            // initalise page tempate map with basic info about mempool
-            mstch::map context {
-                    {"mempool_size",  std::to_string(mempool_txs.size())},
-                    {"mempooltxs" ,   mstch::array()}
-            };
+            return std::min(tx_blk_height, current_blockchain_height);
+        }
 
-            // get reference to blocks template map to be field below
-            mstch::array& txs = boost::get<mstch::array>(context["mempooltxs"]);
+        /**
+         * Check outputs of a block for these that belong
+         * to our address and viewkey.
+         */
+        void
+        check_block_outputs(uint64_t blk_height,
+                            uint64_t blk_timestamp,
+                            const vector<output_info>& outputs_info,
+                            chunk_result& result)
+        {
+            // outputs of the same tx share tx public key, so
+            // derivation is generated only once for each tx in the block.
+            // the value is empty if the derivation failed.
+            unordered_map<crypto::public_key,
+                          boost::optional<crypto::key_derivation>> derivations;
 
-            // for each transaction in the memory pool
-            for (size_t i = 0; i < mempool_txs.size(); ++i)
+            // go through all outputs in each block
+            // and search for our outputs
+            for (const xmreg::output_info& out_info : outputs_info)
             {
-                // get transaction info of the tx in the mempool
-                tx_info _tx_info = mempool_txs.at(i);
+                auto it = derivations.find(out_info.tx_pub_key);
 
-                // calculate difference between tx in mempool and server timestamps
-                array<size_t, 5> delta_time = timestamp_difference(
-                                              server_timestamp,
-                                              _tx_info.receive_time);
+                if (it == derivations.end())
+                {
+                    // public transaction key is combined with our viewkey
+                    // to create, so called, derived key.
+                    crypto::key_derivation derivation;
 
-                // use only hours, so if we have days, add
-                // it to hours
-                uint64_t delta_hours {delta_time[1]*24 + delta_time[2]};
+                    ++result.no_of_derivations;
 
-                string age_str = fmt::format("{:02d}:{:02d}:{:02d}",
-                                             delta_hours,
-                                             delta_time[3], delta_time[4]);
+                    bool r = generate_key_derivation(out_info.tx_pub_key,
+                                                     prv_view_key,
+                                                     derivation);
 
-                // if more than 99 hourse, change formating
-                // for the template
-                if (delta_hours > 99)
+                    if (!r)
+                    {
+                        cerr << "cant derive key for tx: "
+                             << out_info.tx_hash << endl;
+                    }
+
+                    it = derivations.emplace(
+                            out_info.tx_pub_key,
+                            r ? boost::make_optional(derivation)
+                              : boost::none).first;
+                }
+
+                if (!it->second)
                 {
-                    age_str = fmt::format("{:03d}:{:02d}:{:02d}",
-                                             delta_hours,
-                                             delta_time[3], delta_time[4]);
+                    continue;
                 }
 
-                // sum xmr in inputs and ouputs in the given tx
-                pair<uint64_t, uint64_t> sum_inputs  = sum_xmr_inputs(_tx_info.tx_json);
-                pair<uint64_t, uint64_t> sum_outputs = sum_xmr_outputs(_tx_info.tx_json);
+                const crypto::key_derivation& derivation = *(it->second);
 
-                // get mixin number in each transaction
-                vector<uint64_t> mixin_numbers = get_mixin_no_in_txs(_tx_info.tx_json);
+                // get the tx output public key
+                // that normally would be generated for us,
+                // if someone had sent us some xmr.
+                crypto::public_key generated_pubkey;
 
-                // set output page template map
-                txs.push_back(mstch::map {
-                        {"timestamp"     , xmreg::timestamp_to_str(_tx_info.receive_time)},
-                        {"age"           , age_str},
-                        {"hash"          , fmt::format("{:s}", _tx_info.id_hash)},
-                        {"fee"           , fmt::format("{:0.3f}", XMR_AMOUNT(_tx_info.fee))},
-                        {"xmr_inputs"    , fmt::format("{:0.2f}", XMR_AMOUNT(sum_inputs.first))},
-                        {"xmr_outputs"   , fmt::format("{:0.2f}", XMR_AMOUNT(sum_outputs.first))},
-                        {"no_inputs"     , sum_inputs.second},
-                        {"no_outputs"    , sum_outputs.second},
-                        {"mixin"         , fmt::format("{:d}", mixin_numbers.at(0) - 1)},
-                        {"txsize"        , fmt::format("{:0.2f}", static_cast<double>(_tx_info.blob_size)/1024.0)}
-                });
-            }
+                derive_public_key(derivation,
+                                  out_info.index_in_tx,
+                                  address.m_spend_public_key,
+                                  generated_pubkey);
 
-            // read index.html
-            string mempool_html = xmreg::read(TMPL_MEMPOOL);
+                if (out_info.out_pub_key == generated_pubkey)
+                {
+                    cout << "found output " << endl;
 
-            // render the page
-            return mstch::render(mempool_html, context);
+                    result.found.push_back({out_info, blk_timestamp, blk_height});
+                }
+            } // for (const xmreg::output_info& out_info : outputs_info)
         }
 
+        /**
+         * Prepare for results of chunks from first_chunk to last_chunk
+         * (inclusive), i.e., these with blocks of this search, out of
+         * all no_of_chunks chunks of the pass. If there are no such
+         * chunks, the search is finished right away.
+         */
+        void
+        start_merging(uint64_t no_of_chunks,
+                      uint64_t first_chunk, uint64_t last_chunk)
+        {
+            std::lock_guard<std::mutex> lck (outputs_mutex);
 
-        string
-        show_block(uint64_t _blk_height)
+            chunk_results.assign(no_of_chunks, chunk_result {});
+
+            next_chunk_to_merge = first_chunk;
+            last_chunk_to_merge = last_chunk;
+
+            scan_failed = false;
+
+            merge_chunks();
+        }
+
+        /**
+         * Save result of a scanned chunk and merge
+         * all chunks that can be merged now.
+         */
+        void
+        chunk_done(uint64_t chunk_i, chunk_result&& result)
         {
-            // get block at the given height i
-            block blk;
+            std::lock_guard<std::mutex> lck (outputs_mutex);
 
-            if (!mcore->get_block_by_height(_blk_height, blk))
+            // chunks after a failed one, and chunks without
+            // blocks of this search, are not needed
+            if (scan_failed || search_finished
+                || chunk_i < next_chunk_to_merge || chunk_i > last_chunk_to_merge)
             {
-                cerr << "Cant get block: " << _blk_height << endl;
-                return fmt::format("Cant get block {:d}!", _blk_height);
+                return;
             }
 
-            // get block's hash
-            crypto::hash blk_hash = core_storage->get_block_id_by_height(_blk_height);
+            result.done = true;
 
-            crypto::hash prev_hash = blk.prev_id;
-            crypto::hash next_hash = core_storage->get_block_id_by_height(_blk_height + 1);
+            chunk_results[chunk_i] = std::move(result);
 
-            bool have_next_hash = (next_hash == null_hash ? false : true);
-            bool have_prev_hash = (prev_hash == null_hash ? false : true);
+            merge_chunks();
+        }
 
-            // remove "<" and ">" from the hash string
-            string prev_hash_str = REMOVE_HASH_BRAKETS(fmt::format("{:s}", prev_hash));
-            string next_hash_str = REMOVE_HASH_BRAKETS(fmt::format("{:s}", next_hash));
-
-            // remove "<" and ">" from the hash string
-            string blk_hash_str = REMOVE_HASH_BRAKETS(fmt::format("{:s}", blk_hash));
-
-            // get block timestamp in user friendly format
-            string blk_timestamp = xmreg::timestamp_to_str(blk.timestamp);
+        /**
+         * Move outputs of finished chunks into the outputs array.
+         * Chunks are merged only in height order, so a chunk
+         * waits until all chunks before it are finished.
+         *
+         * Merging stops at the first chunk that could not be read,
+         * so block_id, and the checkpoint, never go past blocks
+         * that were not scanned.
+         *
+         * When the last chunk of the search is merged, or merging
+         * stopped at a failed chunk, the search is finished, without
+         * waiting for the other searches scanned in the same pass.
+         *
+         * Must be called with outputs_mutex locked.
+         */
+        void
+        merge_chunks()
+        {
+            while (!scan_failed
+                   && next_chunk_to_merge <= last_chunk_to_merge
+                   && chunk_results[next_chunk_to_merge].done)
+            {
+                chunk_result& result = chunk_results[next_chunk_to_merge];
 
-            // get age of the block relative to the server time
-            pair<string, string> age = get_age(server_timestamp, blk.timestamp);
+                if (!result.ok)
+                {
+                    cerr << "Cant read outputs of blocks after " << block_id
+                         << ". Search stopped there." << endl;
 
-            // get time from the last block
-            string delta_time {"N/A"};
+                    scan_failed = true;
 
-            if (have_prev_hash)
-            {
-                block prev_blk = core_storage->get_db().get_block(prev_hash);
+                    chunk_results.clear();
+                    chunk_results.shrink_to_fit();
 
-                pair<string, string> delta_diff = get_age(blk.timestamp, prev_blk.timestamp);
+                    break;
+                }
 
-                delta_time = delta_diff.first;
-            }
+                for (const found_output& found: result.found)
+                {
+                    add_output(found);
+                }
 
-            // get block size in bytes
-            uint64_t blk_size = get_object_blobsize(blk);
+                // chunk could have been cut short if user left
+                if (result.last_height > 0)
+                {
+                    block_id       = result.last_height;
+                    last_timestamp = result.last_timestamp;
+                    timestamp_str  = xmreg::timestamp_to_str(last_timestamp);
+                }
 
-            // miner reward tx
-            transaction coinbase_tx = blk.miner_tx;
+                // free memory of the merged chunk
+                result.found.clear();
+                result.found.shrink_to_fit();
 
-            // transcation in the block
-            vector<crypto::hash> tx_hashes = blk.tx_hashes;
+                ++next_chunk_to_merge;
+            }
 
+            if (!search_finished
+                && (scan_failed || next_chunk_to_merge > last_chunk_to_merge))
+            {
+                finish_search();
+            }
+        }
 
-            bool have_txs = !blk.tx_hashes.empty();
+        /**
+         * Save checkpoint of the search and mark it as finished.
+         *
+         * Must be called with outputs_mutex locked.
+         */
+        void
+        finish_search()
+        {
+            save_checkpoint();
 
-            // sum of all transactions in the block
-            uint64_t sum_fees = 0;
+            chunk_results.clear();
+            chunk_results.shrink_to_fit();
 
-            // get tx details for the coinbase tx, i.e., miners reward
-            tx_details txd_coinbase = get_tx_details(blk.miner_tx, true);
+            search_finished = true;
+        }
 
-            // initalise page tempate map with basic info about blockchain
-            mstch::map context {
-                    {"blk_hash"       , blk_hash_str},
-                    {"blk_height"     , _blk_height},
-                    {"blk_timestamp"  , blk_timestamp},
-                    {"prev_hash"      , prev_hash_str},
-                    {"next_hash"      , next_hash_str},
-                    {"have_next_hash" , have_next_hash},
-                    {"have_prev_hash" , have_prev_hash},
-                    {"have_txs"       , have_txs},
-                    {"no_txs"         , std::to_string(blk.tx_hashes.size())},
-                    {"blk_age"        , age.first},
-                    {"delta_time"     , delta_time},
-                    {"blk_nonce"      , blk.nonce},
-                    {"age_format"     , age.second},
-                    {"major_ver"      , std::to_string(blk.major_version)},
-                    {"minor_ver"      , std::to_string(blk.minor_version)},
-                    {"blk_size"       , fmt::format("{:0.4f}",
-                                                    static_cast<double>(blk_size) / 1024.0)},
-                    {"coinbase_txs"   , mstch::array{{txd_coinbase.get_mstch_map()}}},
-                    {"blk_txs"        , mstch::array()}
-            };
+        /**
+         * Add found output to the outputs array.
+         *
+         * Must be called with outputs_mutex locked.
+         */
+        void
+        add_output(const found_output& found)
+        {
+            const output_info& out_info = found.out_info;
 
-            // .push_back(txd_coinbase.get_mstch_map()
+            bool same_tx = (previous_tx_hash == out_info.tx_hash);
 
-           // boost::get<mstch::array>(context["blk_txs"]).push_back(txd_coinbase.get_mstch_map());
+            string out_pub_key_str = REMOVE_HASH_BRAKETS(fmt::format("{:s}",
+                                                         out_info.out_pub_key));
 
-            // now process nomral transactions
-            // get reference to blocks template map to be field below
-            mstch::array& txs = boost::get<mstch::array>(context["blk_txs"]);
+            string tx_hash_str      = REMOVE_HASH_BRAKETS(fmt::format("{:s}",
+                                                          out_info.tx_hash));
 
-            // timescale representation for each tx in the block
-            vector<string> mixin_timescales_str;
+            outputs.push_back(mstch::map {
+                    {"out_pub_key"  , out_pub_key_str},
+                    {"amount"       , out_info.amount},
+                    {"output_idx"   , fmt::format("{:04d}", ++out_idx)},
+                    {"tx_hash"      , tx_hash_str},
+                    {"blk_timestamp", xmreg::timestamp_to_str(found.blk_timestamp)},
+                    {"same_tx"      , !same_tx}
+            });
 
-            // for each transaction in the block
-            for (size_t i = 0; i < blk.tx_hashes.size(); ++i)
-            {
-                // get transaction info of the tx in the mempool
-                const crypto::hash& tx_hash = blk.tx_hashes.at(i);
+            found_outputs.push_back(found);
 
-                // remove "<" and ">" from the hash string
-                string tx_hash_str = REMOVE_HASH_BRAKETS(fmt::format("{:s}", tx_hash));
+            previous_tx_hash = out_info.tx_hash;
+        }
 
+        /**
+         * Key of the search's checkpoint in the custom lmdb database.
+         * Its a hash of the address and the viewkey, so the viewkey
+         * is not stored in the database.
+         */
+        string
+        checkpoint_key() const
+        {
+            string data = "scan_checkpoint" + xmr_address_str
+                          + string(reinterpret_cast<const char*>(&prv_view_key),
+                                   sizeof(prv_view_key));
 
-                // get transaction
-                transaction tx;
+            return pod_to_hex(crypto::cn_fast_hash(data.data(), data.size()));
+        }
 
-                if (!mcore->get_tx(tx_hash, tx))
-                {
-                    cerr << "Cant get tx: " << tx_hash << endl;
-                    continue;
-                }
+        /**
+         * Checkpoints are encrypted with chacha8 using a key
+         * derived from the viewkey, so only the owner of
+         * the viewkey can read found outputs from them.
+         */
+        crypto::chacha8_key
+        checkpoint_encryption_key() const
+        {
+            crypto::chacha8_key key;
 
-                tx_details txd = get_tx_details(tx);
+            crypto::generate_chacha8_key(&prv_view_key, sizeof(prv_view_key), key);
 
-                // add fee to the rest
-                sum_fees += txd.fee;
+            return key;
+        }
 
+        /**
+         * Read outputs found by earlier search of the same address
+         * and viewkey, so that only blocks after it are scanned.
+         *
+         * Returns height from which scanning should start. Its
+         * start_height if there is no usable checkpoint.
+         */
+        uint64_t
+        resume_from_checkpoint(uint64_t start_height)
+        {
+            requested_start = start_height;
 
-                // get mixins in time scale for visual representation
-                //string mixin_times_scale = xmreg::timestamps_time_scale(mixin_timestamps,
-                //                                                        server_timestamp);
+            if (!keys_parsed)
+            {
+                return start_height;
+            }
 
+            string blob;
 
-                // add tx details mstch map to context
-                txs.push_back(txd.get_mstch_map());
+            if (!mylmdb->get_scan_checkpoint(checkpoint_key(), blob))
+            {
+                return start_height;
             }
 
+            crypto::chacha8_iv iv;
 
-            // add total fees in the block to the context
-            context["sum_fees"]   = fmt::format("{:0.6f}",
-                                         XMR_AMOUNT(sum_fees));
+            if (blob.size() < sizeof(iv) + sizeof(checkpoint_header))
+            {
+                cerr << "Checkpoint too short" << endl;
+                return start_height;
+            }
 
-            // get xmr in the block reward
-            context["blk_reward"] = fmt::format("{:0.6f}",
-                                         XMR_AMOUNT(txd_coinbase.xmr_outputs - sum_fees));
+            memcpy(&iv, blob.data(), sizeof(iv));
 
-            // read block.html
-            string block_html = xmreg::read(TMPL_BLOCK);
+            string plain(blob.size() - sizeof(iv), '\0');
 
-            // add header and footer
-            string full_page = get_full_page(block_html);
+            crypto::chacha8(blob.data() + sizeof(iv), plain.size(),
+                            checkpoint_encryption_key(), iv, &plain[0]);
 
-            // render the page
-            return mstch::render(full_page, context);
-        }
+            checkpoint_header header;
 
+            memcpy(&header, plain.data(), sizeof(header));
 
-        string
-        show_block(string _blk_hash)
-        {
-            crypto::hash blk_hash;
+            if (header.magic != CHECKPOINT_MAGIC
+                || plain.size() != sizeof(header)
+                                   + header.no_of_outputs * sizeof(found_output))
+            {
+                cerr << "Cant decrypt checkpoint" << endl;
+                return start_height;
+            }
 
-            if (!xmreg::parse_str_secret_key(_blk_hash, blk_hash))
+            // checkpoint must cover blocks from start_height onwards
+            // and cant be ahead of the blockchain, e.g., after a reorg
+            if (header.scan_start > start_height
+                || header.last_height < start_height
+                || header.last_height > current_blockchain_height)
             {
-                cerr << "Cant parse blk hash: " << blk_hash << endl;
-                return fmt::format("Cant get block {:s} due to block hash parse error!", blk_hash);
+                return start_height;
             }
 
-            uint64_t blk_height;
+            uint64_t resume_height = start_height;
 
-            try
+            if (header.last_height + 1 > start_height + CHECKPOINT_OVERLAP)
             {
-                blk_height = core_storage->get_db().get_block_height(blk_hash);
+                resume_height = header.last_height + 1 - CHECKPOINT_OVERLAP;
             }
-            catch (const BLOCK_DNE& e)
+
+            const found_output* saved_outputs
+                    = reinterpret_cast<const found_output*>(plain.data() + sizeof(header));
+
+            std::lock_guard<std::mutex> lck (outputs_mutex);
+
+            // outputs in the overlap will be found again
+            for (uint64_t i = 0; i < header.no_of_outputs; ++i)
             {
-                cerr << "Block does not exist: " << blk_hash << endl;
-                return fmt::format("Cant get block {:s} because it does not exist!", blk_hash);
+                const found_output& found = saved_outputs[i];
+
+                if (found.blk_height >= start_height
+                    && found.blk_height < resume_height)
+                {
+                    add_output(found);
+                }
             }
-            catch (const std::exception& e)
+
+            if (resume_height > start_height)
             {
-                cerr << "Cant get block: " << blk_hash << endl;
-                return fmt::format("Cant get block {:s} for some uknown reason", blk_hash);
+                block_id       = resume_height - 1;
+                last_timestamp = header.last_timestamp;
+                timestamp_str  = xmreg::timestamp_to_str(last_timestamp);
             }
 
-            return show_block(blk_height);
+            cout << "Resuming search from checkpoint: "
+                 << found_outputs.size() << " outputs up to block "
+                 << resume_height << endl;
+
+            return resume_height;
         }
 
-        string
-        show_tx(string tx_hash_str,
-                string address_str = "",
-                string viewkey_str = "",
-                uint with_ring_signatures = 0)
+        /**
+         * Save outputs found and the last scanned block, so that
+         * next search for the same address and viewkey can start
+         * from there.
+         *
+         * Must be called with outputs_mutex locked.
+         */
+        void
+        save_checkpoint()
         {
+            // searches stopped by the user can have gaps in
+            // the scanned blocks, so they are not saved
+            if (!keys_parsed || user_left)
+            {
+                return;
+            }
 
-            // parse tx hash string to hash object
-            crypto::hash tx_hash;
-
-            if (!xmreg::parse_str_secret_key(tx_hash_str, tx_hash))
+            if (block_id < scan_start)
             {
-                cerr << "Cant parse tx hash: " << tx_hash_str << endl;
-                return string("Cant get tx hash due to parse error: " + tx_hash_str);
+                return;
             }
 
-            // tx age
-            pair<string, string> age;
+            checkpoint_header header {CHECKPOINT_MAGIC,
+                                      requested_start,
+                                      block_id,
+                                      last_timestamp,
+                                      found_outputs.size()};
 
-            string blk_timestamp {"N/A"};
+            string plain(reinterpret_cast<const char*>(&header), sizeof(header));
 
-            // get transaction
-            transaction tx;
+            plain.append(reinterpret_cast<const char*>(found_outputs.data()),
+                         found_outputs.size() * sizeof(found_output));
 
-            if (!mcore->get_tx(tx_hash, tx))
-            {
-                cerr << "Cant get tx in blockchain: " << tx_hash
-                     << ". \n Check mempool now" << endl;
+            crypto::chacha8_iv iv = crypto::rand<crypto::chacha8_iv>();
 
-                vector<pair<tx_info, transaction>> found_txs
-                        = search_mempool(tx_hash);
+            string blob(reinterpret_cast<const char*>(&iv), sizeof(iv));
 
-                if (!found_txs.empty())
-                {
-                    // there should be only one tx found
-                    tx = found_txs.at(0).second;
+            blob.resize(sizeof(iv) + plain.size());
 
-                    // since its tx in mempool, it has no blk yet
-                    // so use its recive_time as timestamp to show
+            crypto::chacha8(plain.data(), plain.size(),
+                            checkpoint_encryption_key(), iv, &blob[sizeof(iv)]);
 
-                    uint64_t tx_recieve_timestamp
-                            = found_txs.at(0).first.receive_time;
+            mylmdb->write_scan_checkpoint(checkpoint_key(), blob);
+        }
 
-                    blk_timestamp = xmreg::timestamp_to_str(tx_recieve_timestamp);
+        /**
+         * Copy of outputs found so far, safe to use
+         * while the search is still running.
+         */
+        mstch::array
+        get_outputs()
+        {
+            std::lock_guard<std::mutex> lck (outputs_mutex);
+            return outputs;
+        }
 
-                    age = get_age(server_timestamp, tx_recieve_timestamp,
-                                  FULL_AGE_FORMAT);
-                }
-                else
-                {
-                    // tx is nowhere to be found :-(
-                    return string("Cant get tx: " + tx_hash_str);
-                }
-            }
+        string
+        get_timestamp_str()
+        {
+            std::lock_guard<std::mutex> lck (outputs_mutex);
+            return timestamp_str;
+        }
 
-            tx_details txd = get_tx_details(tx);
+        ~search_class_test()
+        {
+            cout << "destroy search_class_test" << endl;
+        }
+    };
 
-            uint64_t tx_blk_height {0};
 
-            bool tx_blk_found {false};
+    /**
+     * Runs searches for outputs on a fixed number of worker
+     * threads. Searches waiting for a free worker are kept
+     * in a bounded queue, so that many users at once cant
+     * start an unlimited number of threads.
+     *
+     * When a worker becomes free, it takes all the searches
+     * waiting in the queue and scans the blocks for them in a
+     * single pass, instead of reading the same blocks once
+     * for each search.
+     */
+    class search_scheduler
+    {
+        // max number of searches scanned together in one pass
+        static const size_t MAX_SEARCHES_PER_PASS {16};
 
-            try
-            {
-                tx_blk_height = core_storage->get_db().get_tx_block_height(tx_hash);
-                tx_blk_found = true;
-            }
-            catch (exception& e)
-            {
-                cerr << "Cant get block height: " << tx_hash
-                     << e.what() << endl;
-            }
+        size_t max_queue_size;
 
+        deque<shared_ptr<search_class_test>> queue;
 
-            // get block cointaining this tx
-            block blk;
+        // searches being run by the workers
+        set<shared_ptr<search_class_test>> running;
 
-            if (tx_blk_found && !mcore->get_block_by_height(tx_blk_height, blk))
+        // threads scanning chunks of blocks, shared by all the
+        // workers, so that at most one thread per core is scanning
+        thread_pool scan_pool;
+
+        vector<std::thread> workers;
+
+        std::mutex              m_mutex;
+        std::condition_variable m_cv;
+        bool                    m_stop {false};
+
+    public:
+
+        search_scheduler(size_t no_of_workers, size_t _max_queue_size)
+            : max_queue_size {_max_queue_size},
+              scan_pool {std::max(1u, std::thread::hardware_concurrency())}
+        {
+            for (size_t i = 0; i < no_of_workers; ++i)
             {
-                cerr << "Cant get block: " << tx_blk_height << endl;
+                workers.emplace_back(&search_scheduler::work, this);
             }
+        }
 
-            string tx_blk_height_str {"N/A"};
-
-            if (tx_blk_found)
+        /**
+         * Queue the search to be run by the first free worker.
+         *
+         * Returns false if the queue is full.
+         */
+        bool
+        submit(shared_ptr<search_class_test> search)
+        {
             {
-                // calculate difference between tx and server timestamps
-                age = get_age(server_timestamp, blk.timestamp, FULL_AGE_FORMAT);
+                std::lock_guard<std::mutex> lck (m_mutex);
 
-                blk_timestamp = xmreg::timestamp_to_str(blk.timestamp);
+                if (queue.size() >= max_queue_size)
+                {
+                    return false;
+                }
 
-                tx_blk_height_str = std::to_string(tx_blk_height);
+                queue.push_back(search);
             }
 
-            // payments id. both normal and encrypted (payment_id8)
-            string pid_str   = REMOVE_HASH_BRAKETS(fmt::format("{:s}", txd.payment_id));
-            string pid8_str  = REMOVE_HASH_BRAKETS(fmt::format("{:s}", txd.payment_id8));
+            m_cv.notify_one();
 
+            return true;
+        }
 
-            // initalise page tempate map with basic info about blockchain
-            mstch::map context {
-                    {"tx_hash"              , tx_hash_str},
-                    {"tx_pub_key"           , REMOVE_HASH_BRAKETS(fmt::format("{:s}", txd.pk))},
-                    {"blk_height"           , tx_blk_height_str},
-                    {"tx_size"              , fmt::format("{:0.4f}",
-                                                   static_cast<double>(txd.size) / 1024.0)},
-                    {"tx_fee"               , fmt::format("{:0.12f}", XMR_AMOUNT(txd.fee))},
-                    {"blk_timestamp"        , blk_timestamp},
-                    {"blk_timestamp_uint"   , blk.timestamp},
-                    {"delta_time"           , age.first},
-                    {"inputs_no"            , txd.input_key_imgs.size()},
-                    {"has_inputs"           , !txd.input_key_imgs.empty()},
-                    {"outputs_no"           , txd.output_pub_keys.size()},
-                    {"has_payment_id"       , txd.payment_id  != null_hash},
-                    {"has_payment_id8"      , txd.payment_id8 != null_hash8},
-                    {"payment_id"           , pid_str},
-                    {"payment_id8"          , pid8_str},
-                    {"xmr_address"          , address_str},
-                    {"xmr_viewkey"          , viewkey_str},
-                    {"extra"                , txd.get_extra_str()},
-                    {"with_ring_signatures" , static_cast<bool>(with_ring_signatures)}
-            };
-
-            string server_time_str = xmreg::timestamp_to_str(server_timestamp, "%F");
-
-            mstch::array inputs = mstch::array{};
+        /**
+         * Position of the search in the queue, starting from 1.
+         * 0 if the search is not waiting, i.e., its already running,
+         * finished or was never submitted.
+         */
+        size_t
+        queue_position(const search_class_test* search)
+        {
+            std::lock_guard<std::mutex> lck (m_mutex);
 
-            mstch::array mixins_timescales;
+            for (size_t i = 0; i < queue.size(); ++i)
+            {
+                if (queue[i].get() == search)
+                {
+                    return i + 1;
+                }
+            }
 
-            double timescale_scale {0.0}; // size of one '_' in days
+            return 0;
+        }
 
-            uint64_t input_idx {0};
+        /**
+         * Remove the search from the queue, if its still there
+         */
+        void
+        remove(const search_class_test* search)
+        {
+            std::lock_guard<std::mutex> lck (m_mutex);
+
+            queue.erase(std::remove_if(queue.begin(), queue.end(),
+                                       [&](const shared_ptr<search_class_test>& s)
+                                       {
+                                           return s.get() == search;
+                                       }),
+                        queue.end());
+        }
 
-            // make timescale maps for mixins in input
-            for (const txin_to_key& in_key: txd.input_key_imgs)
+        ~search_scheduler()
+        {
             {
-                // get absolute offsets of mixins
-                std::vector<uint64_t> absolute_offsets
-                        = cryptonote::relative_output_offsets_to_absolute(
-                                in_key.key_offsets);
-
-                // get public keys of outputs used in the mixins that match to the offests
-                std::vector<cryptonote::output_data_t> outputs;
-                core_storage->get_db().get_output_key(in_key.amount,
-                                                      absolute_offsets,
-                                                      outputs);
+                std::lock_guard<std::mutex> lck (m_mutex);
+                m_stop = true;
 
-                vector<uint64_t> mixin_timestamps;
+                // stop searches that are running
+                for (const shared_ptr<search_class_test>& search: running)
+                {
+                    search->user_left = true;
+                }
+            }
 
-                inputs.push_back(mstch::map {
-                    {"in_key_img", REMOVE_HASH_BRAKETS(fmt::format("{:s}", in_key.k_image))},
-                    {"amount"    , fmt::format("{:0.12f}", XMR_AMOUNT(in_key.amount))},
-                    {"input_idx" , fmt::format("{:02d}", input_idx)},
-                    {"mixins"    , mstch::array{}},
-                    {"ring_sigs" , txd.get_ring_sig_for_input(input_idx)}
-                });
+            m_cv.notify_all();
 
+            for (std::thread& worker: workers)
+            {
+                worker.join();
+            }
+        }
 
-                // get reference to mixins array created above
-                mstch::array& mixins = boost::get<mstch::array>(
-                            boost::get<mstch::map>(inputs.back())["mixins"]);
+    private:
 
-                // mixin counter
-                size_t count = 0;
+        void
+        work()
+        {
+            while (true)
+            {
+                // searches waiting in the queue are run together,
+                // in one pass over the blocks
+                vector<shared_ptr<search_class_test>> group;
 
-                // for each found output public key find its block to get timestamp
-                for (const uint64_t &i: absolute_offsets)
                 {
-                    // get basic information about mixn's output
-                    cryptonote::output_data_t output_data = outputs.at(count);
+                    std::unique_lock<std::mutex> lck (m_mutex);
 
-                    // get pair pair<crypto::hash, uint64_t> where first is tx hash
-                    // and second is local index of the output i in that tx
-                    tx_out_index tx_out_idx =
-                            core_storage->get_db().get_output_tx_and_index(in_key.amount, i);
+                    m_cv.wait(lck, [this]() { return m_stop || !queue.empty(); });
 
-                    // get block of given height, as we want to get its timestamp
-                    cryptonote::block blk;
+                    if (m_stop)
+                    {
+                        return;
+                    }
 
-                    if (!mcore->get_block_by_height(output_data.height, blk))
+                    while (!queue.empty() && group.size() < MAX_SEARCHES_PER_PASS)
                     {
-                        cerr << "- cant get block of height: " << output_data.height << endl;
-                        return fmt::format("- cant get block of height: {}", output_data.height);
+                        group.push_back(queue.front());
+                        queue.pop_front();
+
+                        running.insert(group.back());
                     }
+                }
 
-                    // get age of mixin relative to server time
-                    pair<string, string> mixin_age = get_age(server_timestamp,
-                                                             blk.timestamp,
-                                                             FULL_AGE_FORMAT);
-                    // get mixin transaction
-                    transaction mixin_tx;
+                vector<search_class_test*> to_run;
 
-                    if (!mcore->get_tx(tx_out_idx.first, mixin_tx))
+                for (const shared_ptr<search_class_test>& search: group)
+                {
+                    if (search->user_left)
                     {
-                        cerr << "Cant get tx: " << tx_out_idx.first << endl;
-                        return fmt::format("Cant get tx: {:s}", tx_out_idx.first);
+                        search->search_finished = true;
+                        continue;
                     }
 
-                     // mixin tx details
-                    tx_details mixin_txd = get_tx_details(mixin_tx, true);
+                    to_run.push_back(search.get());
+                }
 
-                    mixins.push_back(mstch::map {
-                            {"mix_blk"        , fmt::format("{:08d}", output_data.height)},
-                            {"mix_pub_key"    , REMOVE_HASH_BRAKETS(fmt::format("{:s}",
-                                                    output_data.pubkey))},
-                            {"mix_tx_hash"    , REMOVE_HASH_BRAKETS(fmt::format("{:s}",
-                                                    tx_out_idx.first))},
-                            {"mix_out_indx"   , fmt::format("{:d}", tx_out_idx.second)},
-                            {"mix_timestamp"  , xmreg::timestamp_to_str(blk.timestamp)},
-                            {"mix_age"        , mixin_age.first},
-                            {"mix_mixin_no"   , mixin_txd.mixin_no},
-                            {"mix_inputs_no"  , mixin_txd.input_key_imgs.size()},
-                            {"mix_outputs_no" , mixin_txd.output_pub_keys.size()},
-                            {"mix_age_format" , mixin_age.second},
-                            {"mix_idx"        , fmt::format("{:02d}", count)},
-                    });
+                if (!to_run.empty())
+                {
+                    search_class_test::search_together(to_run, scan_pool);
+                }
 
-                    // get mixin timestamp from its orginal block
-                    mixin_timestamps.push_back(blk.timestamp);
+                std::lock_guard<std::mutex> lck (m_mutex);
 
-                    ++count;
+                for (const shared_ptr<search_class_test>& search: group)
+                {
+                    running.erase(search);
+                }
+            }
+        }
+    };
 
-                } // for (const uint64_t &i: absolute_offsets)
 
-                // get mixins in time scale for visual representation
-                pair<string, double> mixin_times_scale = xmreg::timestamps_time_scale(
-                                                            mixin_timestamps,
-                                                            server_timestamp, 170);
+    /**
+     * Mempool as seen at some moment. Never changed after
+     * being made, so it can be read by many threads at once.
+     */
+    struct mempool_snapshot
+    {
+        // true if the mempool was obtained from the deamon
+        bool ok {false};
 
-                // save resolution of mixin timescales
-                timescale_scale = mixin_times_scale.second;
+        // when the snapshot was made
+        time_t timestamp {0};
 
-                // save the string timescales for later to show
-                mixins_timescales.push_back(mstch::map {
-                    {"timescale", mixin_times_scale.first}});
+        // txs info as returned by the deamon
+        vector<tx_info> txs_info;
 
-                input_idx++;
-            } // for (const txin_to_key& in_key: txd.input_key_imgs)
+        // summaries of txs_info's json, in the same order
+        vector<mempool_tx_summary> txs_summaries;
 
-            context["server_time"]      = server_time_str;
-            context["inputs"]           = inputs;
-            context["timescales"]       = mixins_timescales;
-            context["timescales_scale"] = fmt::format("{:0.2f}",
-                                                timescale_scale / 3600.0 / 24.0); // in days
+        // txs parsed from their blobs, if the deamon provides them
+        vector<pair<tx_info, transaction>> txs;
 
-            // get indices of outputs in amounts tables
-            vector<uint64_t> out_amount_indices;
+        // tx hash -> its index in txs
+        unordered_map<crypto::hash, size_t> tx_index;
+    };
 
-            try
-            {
 
-                uint64_t tx_index;
+    /**
+     * Polls the deamon for its mempool in a background thread
+     * and keeps the latest mempool_snapshot.
+     *
+     * Requests only read the current snapshot, and
+     * never wait for the deamon.
+     */
+    class mempool_poller
+    {
+        // check if we have tx_blob member in tx_info structure
+        static const bool HAVE_TX_BLOB {
+            HAS_MEMBER(cryptonote::tx_info, tx_blob)
+        };
 
-                if (core_storage->get_db().tx_exists(txd.hash, tx_index))
-                {
-                    out_amount_indices = core_storage->get_db()
-                            .get_tx_amount_output_indices(tx_index);
-                }
-                else
-                {
-                    cerr << "get_tx_outputs_gindexs failed to find transaction with id = " << txd.hash;
-                }
+        // snapshot is out of date if not refreshed for that many
+        // refresh intervals, e.g., when the deamon stopped responding
+        static const int64_t STALE_AFTER_INTERVALS {3};
 
-            }
-            catch(const exception& e)
-            {
-                cerr << e.what() << endl;
-            }
+        rpccalls rpc;
 
-            uint64_t output_idx {0};
+        std::chrono::seconds refresh_interval;
 
-            mstch::array outputs;
+        shared_ptr<const mempool_snapshot> current_snapshot;
 
-            for (pair<txout_to_key, uint64_t>& outp: txd.output_pub_keys)
-            {
+        std::thread             m_poller;
+        std::atomic<bool>       m_poller_stop {false};
+        std::mutex              m_poller_mutex;
+        std::condition_variable m_poller_cv;
 
-                // total number of ouputs in the blockchain for this amount
-                uint64_t num_outputs_amount = core_storage->get_db()
-                                                .get_num_outputs(outp.second);
+    public:
 
-                string out_amount_index_str {"N/A"};
+        mempool_poller(string _deamon_url,
+                       std::chrono::seconds _refresh_interval
+                            = std::chrono::seconds(5))
+            : rpc {_deamon_url},
+              refresh_interval {_refresh_interval},
+              current_snapshot {make_shared<mempool_snapshot>()}
+        {}
 
-                // outputs in tx in them mempool dont have yet global indices
-                // thus for them, we print N/A
-                if (!out_amount_indices.empty())
-                {
-                    out_amount_index_str = fmt::format("{:d}",
-                                            out_amount_indices.at(output_idx));
-                }
+        /**
+         * Current mempool. Empty and not ok, until
+         * the mempool is obtained from the deamon for the first time.
+         */
+        shared_ptr<const mempool_snapshot>
+        get_snapshot() const
+        {
+            return std::atomic_load(&current_snapshot);
+        }
 
-                outputs.push_back(mstch::map {
-                      {"out_pub_key"   , REMOVE_HASH_BRAKETS(fmt::format("{:s}", outp.first.key))},
-                      {"amount"        , fmt::format("{:0.12f}", XMR_AMOUNT(outp.second))},
-                      {"amount_idx"    , out_amount_index_str},
-                      {"num_outputs"   , fmt::format("{:d}", num_outputs_amount)},
-                      {"output_idx"    , fmt::format("{:02d}", output_idx++)}
-                });
+        /**
+         * True if the snapshot was not obtained from the deamon,
+         * or is older than a few refresh intervals
+         */
+        bool
+        is_stale(const mempool_snapshot& snapshot) const
+        {
+            if (!snapshot.ok)
+            {
+                return true;
             }
 
-            context["outputs"] = outputs;
-
-            // read tx.html
-            string tx_html = xmreg::read(TMPL_TX);
+            int64_t age = std::time(nullptr) - snapshot.timestamp;
 
-            // add header and footer
-            string full_page = get_full_page(tx_html);
-
-            // render the page
-            return mstch::render(full_page, context);
+            return age > STALE_AFTER_INTERVALS * refresh_interval.count();
         }
 
-
-        string
-        get_search_status(string uuid)
+        /**
+         * Get mempool from the deamon and make it the current snapshot
+         */
+        bool
+        refresh()
         {
+            shared_ptr<mempool_snapshot> snapshot = make_shared<mempool_snapshot>();
 
-            // check if we have a search thread with given uuid
-            map<string, shared_ptr<xmreg::search_class_test>>::iterator it;
-
-            it = searching_threads.find(uuid);
+            snapshot->timestamp = std::time(nullptr);
 
-            // if not such thread
-            if (it == searching_threads.end())
+            if (!rpc.get_mempool(snapshot->txs_info))
             {
-                return "No search thread found for this uuid: " + uuid;
+                // the previous snapshot is kept, and its
+                // timestamp shows how old it is
+                cerr << "Getting mempool failed " << endl;
+                return false;
             }
 
+            // parse json of each tx once, here, rather than
+            // on each view of the mempool
+            snapshot->txs_summaries.resize(snapshot->txs_info.size());
 
-            uint64_t block_id         = searching_threads[uuid]->block_id;
-            string timestamp_str      = searching_threads[uuid]->timestamp_str;
-            uint64_t blk_chain_height = searching_threads[uuid]->current_blockchain_height;
-            uint64_t no_outputs_found = searching_threads[uuid]->outputs.size();
-            string xmr_address_str    = searching_threads[uuid]->xmr_address_str;
-            string xmr_viewkey_str    = searching_threads[uuid]->viewkey_str;
-            bool search_finished      = searching_threads[uuid]->search_finished;
-
-            mstch::map context {
-                    {"block_id"             , block_id},
-                    {"blk_chain_height"     , blk_chain_height},
-                    {"current_blk_timestamp", timestamp_str},
-                    {"txs_found"            , mstch::array{}},
-                    {"no_outputs_found"     , no_outputs_found},
-                    {"xmr_address"          , xmr_address_str},
-                    {"xmr_viewkey"          , xmr_viewkey_str},
-                    {"refresh"              , !search_finished},
-                    {"search_finished"      , search_finished},
-                    {"uuid"                 , uuid}
-            };
-
-            uint64_t sum_xmr {0};
-
-            string tx_hash {""};
-
-            // initialize tx_hash with first tx found
-            if (!searching_threads[uuid]->outputs.empty())
+            for (size_t i = 0; i < snapshot->txs_info.size(); ++i)
             {
-                mstch::map& output_map = boost::get<mstch::map>(searching_threads[uuid]->outputs[0]);
-                //tx_hash = boost::get<string>(output_map["tx_hash"]);
+                summarize_tx_json(snapshot->txs_info[i].tx_json,
+                                  snapshot->txs_summaries[i]);
             }
 
-            // for each output found
-            for (mstch::node& output: searching_threads[uuid]->outputs)
+            // if we have tx blob, parse txs now, so that
+            // requests dont need to do it.
+            // this info can also be obtained from json that is
+            // normally returned by the RCP call
+            if (HAVE_TX_BLOB)
             {
-                mstch::map& output_map = boost::get<mstch::map>(output);
-
-                uint64_t amount = boost::get<uint64_t>(output_map["amount"]);
-                string current_tx_hash = boost::get<string>(output_map["tx_hash"]);
+                for (const tx_info& _tx_info: snapshot->txs_info)
+                {
+                    // get tx_blob if exists
+                    string tx_blob = get_tx_blob(_tx_info);
 
-                output_map["amount_str"] = fmt::format("{:0.12f}", XMR_AMOUNT(amount));
+                    if (tx_blob.empty())
+                    {
+                        cerr << "tx_blob is empty. Probably its not a custom deamon." << endl;
+                        continue;
+                    }
 
-                output_map["same_tx"]    = (tx_hash != current_tx_hash);
+                    // pare tx_blob into tx class
+                    transaction tx;
 
-                if (tx_hash != current_tx_hash)
-                    tx_hash = current_tx_hash;
+                    if (!parse_and_validate_tx_from_blob(tx_blob, tx))
+                    {
+                        cerr << "Cant get tx from blob" << endl;
+                        continue;
+                    }
 
-                boost::get<mstch::array>(
-                        context["txs_found"]).push_back(output_map);
+                    snapshot->tx_index[get_transaction_hash(tx)] = snapshot->txs.size();
 
-                sum_xmr += amount;
+                    snapshot->txs.push_back(make_pair(_tx_info, tx));
+                }
+            }
+            else
+            {
+                // @TODO make tx_info from json
+                // if dont have tx_blob member, construct tx_info
+                // from json obtained from the rpc call
             }
 
-            context.insert(
-                    {"sum_xmr", fmt::format("{:0.12f}", XMR_AMOUNT(sum_xmr))}
-            );
+            snapshot->ok = true;
 
-            // read txs_found.html
-            string tx_found_html = xmreg::read(TMPL_TXS_FOUND);
+            std::atomic_store(&current_snapshot,
+                              shared_ptr<const mempool_snapshot>(snapshot));
 
-            map<string, string> partials {
-                    {"tx_output_head", xmreg::read(string(TMPL_PARIALS_DIR)
-                                                   + "/tx_output_header.html")},
-                    {"tx_output_row" , xmreg::read(string(TMPL_PARIALS_DIR)
-                                                   + "/tx_output_row.html")}
-            };
+            return true;
+        }
 
-            // add header and footer
-            string full_page = get_full_page(tx_found_html);
+        void
+        start()
+        {
+            if (m_poller.joinable())
+            {
+                return;
+            }
 
-            // render the page
-            return mstch::render(full_page, context, partials);
+            m_poller_stop = false;
 
-        };
+            m_poller = std::thread([this]()
+            {
+                refresh();
 
-        string
-        fire_finish_search(string uuid)
-        {
-            searching_threads[uuid]->user_left = true;
-            //searching_threads.erase(uuid);
-            cout <<  "User left" << endl;
-            return {};
-        };
+                std::unique_lock<std::mutex> lck (m_poller_mutex);
 
+                while (!m_poller_cv.wait_for(lck, refresh_interval,
+                                             [this]() { return m_poller_stop.load(); }))
+                {
+                    refresh();
+                }
+            });
+        }
 
-        string
-        show_my_outputs(string xmr_address_str,
-                        string viewkey_str,
-                        string uuid,
-                        uint64_t since_when = 1)
+        void
+        stop()
         {
-            // remove white characters
-            boost::trim(xmr_address_str);
-            boost::trim(viewkey_str);
-
-            if (xmr_address_str.empty())
+            if (!m_poller.joinable())
             {
-                return string("Monero address not provided!");
+                return;
             }
 
-            if (viewkey_str.empty())
             {
-                return string("Viewkey not provided!");
+                std::lock_guard<std::mutex> lck (m_poller_mutex);
+                m_poller_stop = true;
             }
 
-            // parse string representing given monero address
-            cryptonote::account_public_address address;
-
-            if (!xmreg::parse_str_address(xmr_address_str,  address, 0))
-            {
-                cerr << "Cant parse string address: " << xmr_address_str << endl;
-                return string("Cant parse xmr address: " + xmr_address_str);
-            }
+            m_poller_cv.notify_all();
 
-            // parse string representing given private viewkey
-            crypto::secret_key prv_view_key;
+            m_poller.join();
+        }
 
-            if (!xmreg::parse_str_secret_key(viewkey_str, prv_view_key))
-            {
-                cerr << "Cant parse view key: " << viewkey_str << endl;
-                return string("Cant parse view key: " + viewkey_str);
-            }
+        ~mempool_poller()
+        {
+            stop();
+        }
+    };
 
-            // get the current blockchain height.
-            uint64_t height =
-                    xmreg::MyLMDB::get_blockchain_height(
-                            mcore->get_blkchain_path()) - 1;
 
-            uint64_t out_idx = {0};
+    class page {
 
-            mstch::map context {
-                {"xmr_address"  , xmr_address_str},
-                {"viewkey"      , viewkey_str},
-                {"uuid"         , uuid},
-                {"refresh"      , true}
-            };
+        static const bool FULL_AGE_FORMAT {true};
 
-            mstch::array outputs;
+        // txs details are obtained in parallel only if
+        // there is at least that many txs for each thread
+        static const size_t MIN_TXS_PER_THREAD {16};
 
-            //std::thread t1 {*searching_threads[uuid]};
-            std::thread t1 {&search_class_test::search, searching_threads[uuid].get()};
-            t1.detach();
+        // rendered block and tx pages are cached for that long, as
+        // apart from ages, they can show things that change slowly,
+        // e.g., number of outputs of a given amount
+        static const time_t RENDERED_PAGE_TTL {600}; // seconds
 
-            // read redirect_to_status.html
-            string redirect_html = xmreg::read(TMPL_REDIRECT);
+        // memory for rendered pages, in bytes
+        static const size_t RENDERED_PAGES_CACHE_SIZE {32 * 1024 * 1024};
 
-            // render the page
-            //return mstch::render(redirect_html, context);
-            return get_search_status(uuid);
-        }
+        // ages are put into rendered pages as markers:
+        // AGE_MARKER_BEGIN kind timestamp,full_format AGE_MARKER_END
+        // where kind is 'a' for age and 'f' for its format
+        static const char AGE_MARKER_BEGIN {'\x02'};
+        static const char AGE_MARKER_END   {'\x03'};
 
-        string
-        show_my_tx_outputs(string tx_hash_str,
-                           string xmr_address_str,
-                           string viewkey_str)
-        {
+        // number of searches for outputs run at the same time,
+        // and max number of searches waiting for their turn
+        static const size_t NO_OF_SEARCH_WORKERS {2};
+        static const size_t MAX_QUEUED_SEARCHES  {32};
 
-            // remove white characters
-            boost::trim(tx_hash_str);
-            boost::trim(xmr_address_str);
-            boost::trim(viewkey_str);
+        // searches not asked about their status for that long are removed
+        static const time_t SEARCH_TTL {600}; // seconds
 
-            if (tx_hash_str.empty())
-            {
-                return string("tx hash not provided!");
-            }
+        // how often stale searches are looked for
+        static const time_t STALE_SEARCHES_CHECK_INTERVAL {60}; // seconds
 
-            if (xmr_address_str.empty())
-            {
-                return string("Monero address not provided!");
-            }
+        // hex strings at least that long, but shorter than
+        // a full hash, are searched as prefixes of hashes and keys
+        static const size_t MIN_SEARCH_PREFIX_LENGTH {8};
 
-            if (viewkey_str.empty())
-            {
-                return string("Viewkey not provided!");
-            }
+        // prefix search results per page, and max number of pages,
+        // so that a short prefix cant make the cursor go far
+        static const uint64_t SEARCH_PREFIX_RESULTS_PER_PAGE {25};
+        static const uint64_t MAX_SEARCH_PREFIX_PAGES        {20};
 
-            // parse tx hash string to hash object
-            crypto::hash tx_hash;
+        /**
+         * Rendered page, with age markers instead of ages
+         */
+        struct rendered_page
+        {
+            string html;
+            time_t rendered_at;
+        };
 
-            if (!xmreg::parse_str_secret_key(tx_hash_str, tx_hash))
-            {
-                cerr << "Cant parse tx hash: " << tx_hash_str << endl;
-                return string("Cant get tx hash due to parse error: " + tx_hash_str);
-            }
+        /**
+         * Output used as a mixin in a ring, together
+         * with tx and block it comes from.
+         */
+        struct ring_member
+        {
+            cryptonote::output_data_t output_data;
+            tx_out_index tx_out_idx;
+            uint64_t blk_timestamp;
+            tx_summary tx_sum;
+        };
 
-            // parse string representing given monero address
-            cryptonote::account_public_address address;
+        MicroCore* mcore;
+        Blockchain* core_storage;
 
-            if (!xmreg::parse_str_address(xmr_address_str,  address, 0))
-            {
-                cerr << "Cant parse string address: " << xmr_address_str << endl;
-                return string("Cant parse xmr address: " + xmr_address_str);
-            }
+        // mempool obtained from the deamon in the background
+        mempool_poller mempool_status;
 
-            // parse string representing given private viewkey
-            crypto::secret_key prv_view_key;
+        // custom lmdb database opened once for the whole
+        // program. Its null if the database does not exist.
+        shared_ptr<xmreg::MyLMDB> mylmdb;
 
-            if (!xmreg::parse_str_secret_key(viewkey_str, prv_view_key))
-            {
-                cerr << "Cant parse view key: " << viewkey_str << endl;
-                return string("Cant parse view key: " + viewkey_str);
-            }
+        // html templates read once at startup
+        TemplateRegistry templates;
 
+        // summaries of txs used as mixins, by tx hash.
+        // Popular outputs are mixins in many txs, so
+        // their txs are often needed again.
+        lru_cache<crypto::hash, tx_summary> tx_summaries {50000};
 
-            // tx age
-            pair<string, string> age;
+        // rendered pages of blocks and txs that wont change,
+        // keyed by route and its argument, e.g., "block/1000"
+        lru_cache<string, rendered_page> rendered_pages {RENDERED_PAGES_CACHE_SIZE};
 
-            string blk_timestamp {"N/A"};
 
-            // get transaction
-            transaction tx;
+        // search threads are added and read from
+        // concurrent requests, so access to them is guarded
+        map<string, shared_ptr<xmreg::search_class_test>> searching_threads;
+        std::mutex searching_threads_mutex;
 
-            if (!mcore->get_tx(tx_hash, tx))
-            {
-                cerr << "Cant get tx in blockchain: " << tx_hash
-                     << ". \n Check mempool now" << endl;
+        // removes stale searches in the background, so that they
+        // dont wait for a new search or a status request
+        std::thread             m_evictor;
+        bool                    m_evictor_stop {false};
+        std::mutex              m_evictor_mutex;
+        std::condition_variable m_evictor_cv;
 
-                vector<pair<tx_info, transaction>> found_txs
-                        = search_mempool(tx_hash);
+        // threads getting details of txs of big blocks, shared by
+        // all requests, so that concurrent requests dont start
+        // new threads for each of them
+        thread_pool details_pool {std::max(1u, std::thread::hardware_concurrency())};
 
-                if (!found_txs.empty())
-                {
-                    // there should be only one tx found
-                    tx = found_txs.at(0).second;
+        // runs the searches. Declared last, so that its destroyed,
+        // and the running searches stopped, before anything else.
+        search_scheduler searches {NO_OF_SEARCH_WORKERS, MAX_QUEUED_SEARCHES};
 
-                    // since its tx in mempool, it has no blk yet
-                    // so use its recive_time as timestamp to show
 
-                    uint64_t tx_recieve_timestamp
-                            = found_txs.at(0).first.receive_time;
+    public:
 
-                    blk_timestamp = xmreg::timestamp_to_str(tx_recieve_timestamp);
+        page(MicroCore* _mcore, Blockchain* _core_storage,
+             string _deamon_url, shared_ptr<xmreg::MyLMDB> _mylmdb)
+                : mcore {_mcore},
+                  core_storage {_core_storage},
+                  mempool_status {_deamon_url},
+                  mylmdb {_mylmdb},
+                  templates {TMPL_DIR, TMPL_PARIALS_DIR, TMPL_HEADER, TMPL_FOOTER}
+        {
+            // most often shown pages are kept compiled
+            templates.add_compiled(TMPL_BLOCK);
+            templates.add_compiled(TMPL_TX);
+            templates.add_compiled(TMPL_TXS_FOUND, {
+                    {"tx_output_head", TMPL_PARIALS_DIR "/tx_output_header.html"},
+                    {"tx_output_row" , TMPL_PARIALS_DIR "/tx_output_row.html"}
+            });
+            templates.add_compiled(TMPL_SEARCH_RESULTS, {
+                    {"tx_table_head", TMPL_PARIALS_DIR "/tx_table_header.html"},
+                    {"tx_table_row" , TMPL_PARIALS_DIR "/tx_table_row.html"}
+            });
 
-                    age = get_age(server_timestamp, tx_recieve_timestamp,
-                                  FULL_AGE_FORMAT);
-                }
-                else
-                {
-                    // tx is nowhere to be found :-(
-                    return string("Cant get tx: " + tx_hash_str);
-                }
+            if (!templates.load())
+            {
+                cerr << "Cant load html templates from: " << TMPL_DIR << endl;
             }
 
-            tx_details txd = get_tx_details(tx);
-
-            uint64_t tx_blk_height {0};
-
-            bool tx_blk_found {false};
+            mempool_status.start();
 
-            try
-            {
-                tx_blk_height = core_storage->get_db().get_tx_block_height(tx_hash);
-                tx_blk_found = true;
-            }
-            catch (exception& e)
+            m_evictor = std::thread([this]()
             {
-                cerr << "Cant get block height: " << tx_hash
-                     << e.what() << endl;
-            }
+                const std::chrono::seconds interval {time_t {STALE_SEARCHES_CHECK_INTERVAL}};
 
+                std::unique_lock<std::mutex> lck (m_evictor_mutex);
 
-            // get block cointaining this tx
-            block blk;
+                while (!m_evictor_cv.wait_for(lck, interval,
+                                              [this]() { return m_evictor_stop; }))
+                {
+                    std::lock_guard<std::mutex> lock(searching_threads_mutex);
+                    remove_stale_searches();
+                }
+            });
+        }
 
-            if (tx_blk_found && !mcore->get_block_by_height(tx_blk_height, blk))
+        ~page()
+        {
             {
-                cerr << "Cant get block: " << tx_blk_height << endl;
+                std::lock_guard<std::mutex> lck (m_evictor_mutex);
+                m_evictor_stop = true;
             }
 
-            string tx_blk_height_str {"N/A"};
+            m_evictor_cv.notify_all();
 
-            if (tx_blk_found)
-            {
-                // calculate difference between tx and server timestamps
-                age = get_age(server_timestamp, blk.timestamp, FULL_AGE_FORMAT);
+            m_evictor.join();
+        }
 
-                blk_timestamp = xmreg::timestamp_to_str(blk.timestamp);
+        /**
+         * Reload html templates whenever they change. For development.
+         */
+        bool
+        reload_templates_on_change()
+        {
+            return templates.start_watching();
+        }
 
-                tx_blk_height_str = std::to_string(tx_blk_height);
-            }
+        void add_searching_thread(string uuid, shared_ptr<xmreg::search_class_test>& search_cls)
+        {
+            std::lock_guard<std::mutex> lock(searching_threads_mutex);
 
-            // payments id. both normal and encrypted (payment_id8)
-            string pid_str   = REMOVE_HASH_BRAKETS(fmt::format("{:s}", txd.payment_id));
-            string pid8_str  = REMOVE_HASH_BRAKETS(fmt::format("{:s}", txd.payment_id8));
+            remove_stale_searches();
 
-            // initalise page tempate map with basic info about blockchain
-            mstch::map context {
-                    {"tx_hash"              , tx_hash_str},
-                    {"xmr_address"          , xmr_address_str},
-                    {"viewkey"              , viewkey_str},
-                    {"tx_pub_key"           , REMOVE_HASH_BRAKETS(fmt::format("{:s}", txd.pk))},
-                    {"blk_height"           , tx_blk_height_str},
-                    {"tx_size"              , fmt::format("{:0.4f}",
-                                                          static_cast<double>(txd.size) / 1024.0)},
-                    {"tx_fee"               , fmt::format("{:0.12f}", XMR_AMOUNT(txd.fee))},
-                    {"blk_timestamp"        , blk_timestamp},
-                    {"delta_time"           , age.first},
-                    {"outputs_no"           , txd.output_pub_keys.size()},
-                    {"has_payment_id"       , txd.payment_id  != null_hash},
-                    {"has_payment_id8"      , txd.payment_id8 != null_hash8},
-                    {"payment_id"           , pid_str},
-                    {"payment_id8"          , pid8_str}
-            };
+            searching_threads[uuid] = search_cls;
+        }
 
-            string server_time_str = xmreg::timestamp_to_str(server_timestamp, "%F");
+        /**
+         * Remove searches not asked about their status for SEARCH_TTL,
+         * i.e., finished ones whose users are gone, or abandoned ones.
+         * Still running or queued ones are stopped.
+         *
+         * Must be called with searching_threads_mutex locked.
+         */
+        void
+        remove_stale_searches()
+        {
+            time_t now = std::time(nullptr);
 
-            uint64_t output_idx {0};
+            for (auto it = searching_threads.begin(); it != searching_threads.end();)
+            {
+                shared_ptr<xmreg::search_class_test>& search_cls = it->second;
 
-            // public transaction key is combined with our viewkey
-            // to create, so called, derived key.
-            key_derivation derivation;
+                if (now - search_cls->last_accessed <= SEARCH_TTL)
+                {
+                    ++it;
+                    continue;
+                }
 
-            if (!generate_key_derivation(txd.pk, prv_view_key, derivation))
-            {
-                cerr << "Cant get dervied key for: "  << "\n"
-                     << "pub_tx_key: " << txd.pk << " and "
-                     << "prv_view_key" << prv_view_key << endl;
+                search_cls->user_left = true;
 
-                return string("Cant get key_derivation");
-            }
+                searches.remove(search_cls.get());
 
+                it = searching_threads.erase(it);
+            }
+        }
 
-            mstch::array outputs;
+        /**
+         * Search thread of a given uuid, or null if there is none
+         */
+        shared_ptr<xmreg::search_class_test>
+        get_searching_thread(const string& uuid)
+        {
+            std::lock_guard<std::mutex> lock(searching_threads_mutex);
 
-            uint64_t sum_xmr {0};
+            remove_stale_searches();
 
+            auto it = searching_threads.find(uuid);
 
-            for (pair<txout_to_key, uint64_t>& outp: txd.output_pub_keys)
+            if (it == searching_threads.end())
             {
+                return nullptr;
+            }
 
-                // get the tx output public key
-                // that normally would be generated for us,
-                // if someone had sent us some xmr.
-                public_key pubkey;
+            return it->second;
+        }
 
-                derive_public_key(derivation,
-                                  output_idx,
-                                  address.m_spend_public_key,
-                                  pubkey);
+        /**
+         * @brief show recent transactions and mempool
+         * @param page_no block page to show
+         * @param refresh_page enable autorefresh
+         * @return rendered index page
+         */
+        string
+        index2(uint64_t page_no = 0, bool refresh_page = false)
+        {
 
-                // check if generated public key matches the current output's key
-                bool mine_output = (outp.first.key == pubkey);
+            //get current server timestamp
+            time_t server_timestamp = std::time(nullptr);
 
-                if (mine_output)
-                {
+            // get the current blockchain height. Just to check
+            uint64_t height = mcore->get_current_blockchain_height() - 1;
+
+            // initalise page tempate map with basic info about blockchain
+            mstch::map context {
+                    {"refresh"         , refresh_page},
+                    {"height"          , std::to_string(height)},
+                    {"server_timestamp", xmreg::timestamp_to_str(server_timestamp)}
+            };
+
+            // get index2.html with header and footer
+            shared_ptr<const string> full_page = get_full_page(TMPL_INDEX2);
+
+            // render the page
+            return mstch::render(*full_page, context);
+        }
+
+
+        /**
+         * Render mempool data
+         */
+        string
+        mempool()
+        {
+            //get current server timestamp
+            time_t server_timestamp = std::time(nullptr);
+
+            shared_ptr<const mempool_snapshot> mempool = mempool_status.get_snapshot();
+
+            if (!mempool->ok)
+            {
+              return "Getting mempool failed";
+            }
+
+            const vector<tx_info>& mempool_txs = mempool->txs_info;
+
+            // initalise page tempate map with basic info about mempool.
+            // if the deamon stopped responding, the last mempool
+            // obtained is shown, with the time it was obtained
+            mstch::map context {
+                    {"mempool_size",      std::to_string(mempool_txs.size())},
+                    {"mempool_stale",     mempool_status.is_stale(*mempool)},
+                    {"mempool_timestamp", xmreg::timestamp_to_str(mempool->timestamp)},
+                    {"mempooltxs" ,       mstch::array()}
+            };
+
+            // get reference to blocks template map to be field below
+            mstch::array& txs = boost::get<mstch::array>(context["mempooltxs"]);
+
+            // for each transaction in the memory pool
+            for (size_t i = 0; i < mempool_txs.size(); ++i)
+            {
+                // get transaction info of the tx in the mempool
+                const tx_info& _tx_info = mempool_txs.at(i);
+
+                // calculate difference between tx in mempool and server timestamps
+                array<size_t, 5> delta_time = timestamp_difference(
+                                              server_timestamp,
+                                              _tx_info.receive_time);
+
+                // use only hours, so if we have days, add
+                // it to hours
+                uint64_t delta_hours {delta_time[1]*24 + delta_time[2]};
+
+                string age_str = fmt::format("{:02d}:{:02d}:{:02d}",
+                                             delta_hours,
+                                             delta_time[3], delta_time[4]);
+
+                // if more than 99 hourse, change formating
+                // for the template
+                if (delta_hours > 99)
+                {
+                    age_str = fmt::format("{:03d}:{:02d}:{:02d}",
+                                             delta_hours,
+                                             delta_time[3], delta_time[4]);
+                }
+
+                // sums of xmr in inputs and ouputs, and mixin numbers
+                // in the given tx, obtained when the mempool was fetched
+                const mempool_tx_summary& summary = mempool->txs_summaries.at(i);
+
+                string mixin_str {"N/A"};
+
+                if (!summary.mixin_no.empty())
+                {
+                    mixin_str = fmt::format("{:d}", summary.mixin_no.at(0) - 1);
+                }
+
+                // set output page template map
+                txs.push_back(mstch::map {
+                        {"timestamp"     , xmreg::timestamp_to_str(_tx_info.receive_time)},
+                        {"age"           , age_str},
+                        {"hash"          , fmt::format("{:s}", _tx_info.id_hash)},
+                        {"fee"           , fmt::format("{:0.3f}", XMR_AMOUNT(_tx_info.fee))},
+                        {"xmr_inputs"    , fmt::format("{:0.2f}", XMR_AMOUNT(summary.sum_inputs))},
+                        {"xmr_outputs"   , fmt::format("{:0.2f}", XMR_AMOUNT(summary.sum_outputs))},
+                        {"no_inputs"     , summary.no_inputs},
+                        {"no_outputs"    , summary.no_outputs},
+                        {"mixin"         , mixin_str},
+                        {"txsize"        , fmt::format("{:0.2f}", static_cast<double>(_tx_info.blob_size)/1024.0)}
+                });
+            }
+
+            // get mempool.html
+            shared_ptr<const string> mempool_html = templates.get(TMPL_MEMPOOL);
+
+            // render the page
+            return mstch::render(*mempool_html, context);
+        }
+
+
+        string
+        show_block(uint64_t _blk_height)
+        {
+            //get current server timestamp
+            time_t server_timestamp = std::time(nullptr);
+
+            string cache_key = fmt::format("block/{:d}", _blk_height);
+
+            string cached_html;
+
+            if (get_cached_page(cache_key, server_timestamp, cached_html))
+            {
+                return cached_html;
+            }
+
+            // get block at the given height i
+            block blk;
+
+            if (!mcore->get_block_by_height(_blk_height, blk))
+            {
+                cerr << "Cant get block: " << _blk_height << endl;
+                return fmt::format("Cant get block {:d}!", _blk_height);
+            }
+
+            // get block's hash
+            crypto::hash blk_hash = core_storage->get_block_id_by_height(_blk_height);
+
+            crypto::hash prev_hash = blk.prev_id;
+            crypto::hash next_hash = core_storage->get_block_id_by_height(_blk_height + 1);
+
+            bool have_next_hash = (next_hash == null_hash ? false : true);
+            bool have_prev_hash = (prev_hash == null_hash ? false : true);
+
+            // remove "<" and ">" from the hash string
+            string prev_hash_str = REMOVE_HASH_BRAKETS(fmt::format("{:s}", prev_hash));
+            string next_hash_str = REMOVE_HASH_BRAKETS(fmt::format("{:s}", next_hash));
+
+            // remove "<" and ">" from the hash string
+            string blk_hash_str = REMOVE_HASH_BRAKETS(fmt::format("{:s}", blk_hash));
+
+            // get block timestamp in user friendly format
+            string blk_timestamp = xmreg::timestamp_to_str(blk.timestamp);
+
+            // get age of the block relative to the server time
+            pair<string, string> age = get_age_markers(blk.timestamp);
+
+            // get time from the last block
+            string delta_time {"N/A"};
+
+            if (have_prev_hash)
+            {
+                block prev_blk = core_storage->get_db().get_block(prev_hash);
+
+                pair<string, string> delta_diff = get_age(blk.timestamp, prev_blk.timestamp);
+
+                delta_time = delta_diff.first;
+            }
+
+            // get block size in bytes
+            uint64_t blk_size = get_object_blobsize(blk);
+
+            // miner reward tx
+            transaction coinbase_tx = blk.miner_tx;
+
+            // transcation in the block
+            vector<crypto::hash> tx_hashes = blk.tx_hashes;
+
+
+            bool have_txs = !blk.tx_hashes.empty();
+
+            // sum of all transactions in the block
+            uint64_t sum_fees = 0;
+
+            // get tx details for the coinbase tx, i.e., miners reward
+            tx_details txd_coinbase = get_tx_details(blk.miner_tx, true);
+
+            // initalise page tempate map with basic info about blockchain
+            mstch::map context {
+                    {"blk_hash"       , blk_hash_str},
+                    {"blk_height"     , _blk_height},
+                    {"blk_timestamp"  , blk_timestamp},
+                    {"prev_hash"      , prev_hash_str},
+                    {"next_hash"      , next_hash_str},
+                    {"have_next_hash" , have_next_hash},
+                    {"have_prev_hash" , have_prev_hash},
+                    {"have_txs"       , have_txs},
+                    {"no_txs"         , std::to_string(blk.tx_hashes.size())},
+                    {"blk_age"        , age.first},
+                    {"delta_time"     , delta_time},
+                    {"blk_nonce"      , blk.nonce},
+                    {"age_format"     , age.second},
+                    {"major_ver"      , std::to_string(blk.major_version)},
+                    {"minor_ver"      , std::to_string(blk.minor_version)},
+                    {"blk_size"       , fmt::format("{:0.4f}",
+                                                    static_cast<double>(blk_size) / 1024.0)},
+                    {"coinbase_txs"   , mstch::array{{txd_coinbase.get_mstch_map()}}},
+                    {"blk_txs"        , mstch::array()}
+            };
+
+            // .push_back(txd_coinbase.get_mstch_map()
+
+           // boost::get<mstch::array>(context["blk_txs"]).push_back(txd_coinbase.get_mstch_map());
+
+            // now process nomral transactions
+            // get reference to blocks template map to be field below
+            mstch::array& txs = boost::get<mstch::array>(context["blk_txs"]);
+
+            // timescale representation for each tx in the block
+            vector<string> mixin_timescales_str;
+
+            // get all transactions of the block at once
+            vector<transaction> blk_txs;
+            vector<crypto::hash> missed_txs;
+
+            if (!mcore->get_txs(blk.tx_hashes, blk_txs, missed_txs, _blk_height))
+            {
+                cerr << "Cant get txs in block: " << _blk_height << endl;
+            }
+
+            for (const crypto::hash& tx_hash: missed_txs)
+            {
+                cerr << "Cant get tx: " << tx_hash << endl;
+            }
+
+            vector<tx_details> blk_txs_details = get_txs_details(blk_txs);
+
+            // for each transaction in the block
+            for (tx_details& txd: blk_txs_details)
+            {
+                // add fee to the rest
+                sum_fees += txd.fee;
+
+
+                // get mixins in time scale for visual representation
+                //string mixin_times_scale = xmreg::timestamps_time_scale(mixin_timestamps,
+                //                                                        server_timestamp);
+
+
+                // add tx details mstch map to context
+                txs.push_back(txd.get_mstch_map());
+            }
+
+
+            // add total fees in the block to the context
+            context["sum_fees"]   = fmt::format("{:0.6f}",
+                                         XMR_AMOUNT(sum_fees));
+
+            // get xmr in the block reward
+            context["blk_reward"] = fmt::format("{:0.6f}",
+                                         XMR_AMOUNT(txd_coinbase.xmr_outputs - sum_fees));
+
+            // get compiled block.html with header and footer
+            shared_ptr<const mstch::compiled_template> full_page
+                    = templates.get_compiled(TMPL_BLOCK);
+
+            // render the page
+            string html = mstch::render(*full_page, context);
+
+            if (is_page_cacheable(_blk_height))
+            {
+                rendered_pages.put(cache_key,
+                                   rendered_page {html, server_timestamp},
+                                   html.size());
+            }
+
+            return fill_ages(html, server_timestamp);
+        }
+
+
+        string
+        show_block(string _blk_hash)
+        {
+            crypto::hash blk_hash;
+
+            if (!xmreg::parse_str_secret_key(_blk_hash, blk_hash))
+            {
+                cerr << "Cant parse blk hash: " << blk_hash << endl;
+                return fmt::format("Cant get block {:s} due to block hash parse error!", blk_hash);
+            }
+
+            uint64_t blk_height;
+
+            try
+            {
+                blk_height = core_storage->get_db().get_block_height(blk_hash);
+            }
+            catch (const BLOCK_DNE& e)
+            {
+                cerr << "Block does not exist: " << blk_hash << endl;
+                return fmt::format("Cant get block {:s} because it does not exist!", blk_hash);
+            }
+            catch (const std::exception& e)
+            {
+                cerr << "Cant get block: " << blk_hash << endl;
+                return fmt::format("Cant get block {:s} for some uknown reason", blk_hash);
+            }
+
+            return show_block(blk_height);
+        }
+
+        string
+        show_tx(string tx_hash_str,
+                string address_str = "",
+                string viewkey_str = "",
+                uint with_ring_signatures = 0)
+        {
+            //get current server timestamp
+            time_t server_timestamp = std::time(nullptr);
+
+            // parse tx hash string to hash object
+            crypto::hash tx_hash;
+
+            if (!xmreg::parse_str_secret_key(tx_hash_str, tx_hash))
+            {
+                cerr << "Cant parse tx hash: " << tx_hash_str << endl;
+                return string("Cant get tx hash due to parse error: " + tx_hash_str);
+            }
+
+            // pages for given address and viewkey are not cached
+            bool use_cache = address_str.empty() && viewkey_str.empty();
+
+            string cache_key = fmt::format("tx/{:s}/{:d}", tx_hash_str,
+                                           with_ring_signatures);
+
+            string cached_html;
+
+            if (use_cache && get_cached_page(cache_key, server_timestamp, cached_html))
+            {
+                return cached_html;
+            }
+
+            // tx age
+            pair<string, string> age;
+
+            string blk_timestamp {"N/A"};
+
+            // get transaction
+            transaction tx;
+
+            if (!mcore->get_tx(tx_hash, tx))
+            {
+                cerr << "Cant get tx in blockchain: " << tx_hash
+                     << ". \n Check mempool now" << endl;
+
+                vector<pair<tx_info, transaction>> found_txs
+                        = search_mempool(tx_hash);
+
+                if (!found_txs.empty())
+                {
+                    // there should be only one tx found
+                    tx = found_txs.at(0).second;
+
+                    // since its tx in mempool, it has no blk yet
+                    // so use its recive_time as timestamp to show
+
+                    uint64_t tx_recieve_timestamp
+                            = found_txs.at(0).first.receive_time;
+
+                    blk_timestamp = xmreg::timestamp_to_str(tx_recieve_timestamp);
+
+                    age = get_age_markers(tx_recieve_timestamp, FULL_AGE_FORMAT);
+                }
+                else
+                {
+                    // tx is nowhere to be found :-(
+                    return string("Cant get tx: " + tx_hash_str);
+                }
+            }
+
+            tx_details txd = get_tx_details(tx);
+
+            uint64_t tx_blk_height {0};
+
+            bool tx_blk_found {false};
+
+            try
+            {
+                tx_blk_height = core_storage->get_db().get_tx_block_height(tx_hash);
+                tx_blk_found = true;
+            }
+            catch (exception& e)
+            {
+                cerr << "Cant get block height: " << tx_hash
+                     << e.what() << endl;
+            }
+
+
+            // get block cointaining this tx
+            block blk;
+
+            if (tx_blk_found && !mcore->get_block_by_height(tx_blk_height, blk))
+            {
+                cerr << "Cant get block: " << tx_blk_height << endl;
+            }
+
+            string tx_blk_height_str {"N/A"};
+
+            if (tx_blk_found)
+            {
+                // calculate difference between tx and server timestamps
+                age = get_age_markers(blk.timestamp, FULL_AGE_FORMAT);
+
+                blk_timestamp = xmreg::timestamp_to_str(blk.timestamp);
+
+                tx_blk_height_str = std::to_string(tx_blk_height);
+            }
+
+            // payments id. both normal and encrypted (payment_id8)
+            string pid_str   = REMOVE_HASH_BRAKETS(fmt::format("{:s}", txd.payment_id));
+            string pid8_str  = REMOVE_HASH_BRAKETS(fmt::format("{:s}", txd.payment_id8));
+
+
+            // initalise page tempate map with basic info about blockchain
+            mstch::map context {
+                    {"tx_hash"              , tx_hash_str},
+                    {"tx_pub_key"           , REMOVE_HASH_BRAKETS(fmt::format("{:s}", txd.pk))},
+                    {"blk_height"           , tx_blk_height_str},
+                    {"tx_size"              , fmt::format("{:0.4f}",
+                                                   static_cast<double>(txd.size) / 1024.0)},
+                    {"tx_fee"               , fmt::format("{:0.12f}", XMR_AMOUNT(txd.fee))},
+                    {"blk_timestamp"        , blk_timestamp},
+                    {"blk_timestamp_uint"   , blk.timestamp},
+                    {"delta_time"           , age.first},
+                    {"inputs_no"            , txd.input_key_imgs.size()},
+                    {"has_inputs"           , !txd.input_key_imgs.empty()},
+                    {"outputs_no"           , txd.output_pub_keys.size()},
+                    {"has_payment_id"       , txd.payment_id  != null_hash},
+                    {"has_payment_id8"      , txd.payment_id8 != null_hash8},
+                    {"payment_id"           , pid_str},
+                    {"payment_id8"          , pid8_str},
+                    {"xmr_address"          , address_str},
+                    {"xmr_viewkey"          , viewkey_str},
+                    {"extra"                , txd.get_extra_str()},
+                    {"with_ring_signatures" , static_cast<bool>(with_ring_signatures)}
+            };
+
+            string server_time_str = xmreg::timestamp_to_str(server_timestamp, "%F");
+
+            mstch::array inputs = mstch::array{};
+
+            mstch::array mixins_timescales;
+
+            double timescale_scale {0.0}; // size of one '_' in days
+
+            uint64_t input_idx {0};
+
+            // get all mixins of all inputs at once
+            vector<vector<ring_member>> ring_members;
+
+            if (!resolve_ring_members(txd.input_key_imgs, ring_members))
+            {
+                return fmt::format("Cant get mixins of tx: {:s}", tx_hash_str);
+            }
+
+            // make timescale maps for mixins in input
+            for (const txin_to_key& in_key: txd.input_key_imgs)
+            {
+                vector<uint64_t> mixin_timestamps;
+
+                inputs.push_back(mstch::map {
+                    {"in_key_img", REMOVE_HASH_BRAKETS(fmt::format("{:s}", in_key.k_image))},
+                    {"amount"    , fmt::format("{:0.12f}", XMR_AMOUNT(in_key.amount))},
+                    {"input_idx" , fmt::format("{:02d}", input_idx)},
+                    {"mixins"    , mstch::array{}},
+                    {"ring_sigs" , txd.get_ring_sig_for_input(input_idx)}
+                });
+
+
+                // get reference to mixins array created above
+                mstch::array& mixins = boost::get<mstch::array>(
+                            boost::get<mstch::map>(inputs.back())["mixins"]);
+
+                // mixin counter
+                size_t count = 0;
+
+                // for each mixin of the input
+                for (const ring_member& mixin: ring_members.at(input_idx))
+                {
+                    const cryptonote::output_data_t& output_data = mixin.output_data;
+                    const tx_out_index& tx_out_idx = mixin.tx_out_idx;
+                    const tx_summary& mixin_tx_sum = mixin.tx_sum;
+
+                    // get age of mixin relative to server time
+                    pair<string, string> mixin_age = get_age_markers(mixin.blk_timestamp,
+                                                                     FULL_AGE_FORMAT);
+
+                    mixins.push_back(mstch::map {
+                            {"mix_blk"        , fmt::format("{:08d}", output_data.height)},
+                            {"mix_pub_key"    , REMOVE_HASH_BRAKETS(fmt::format("{:s}",
+                                                    output_data.pubkey))},
+                            {"mix_tx_hash"    , REMOVE_HASH_BRAKETS(fmt::format("{:s}",
+                                                    tx_out_idx.first))},
+                            {"mix_out_indx"   , fmt::format("{:d}", tx_out_idx.second)},
+                            {"mix_timestamp"  , xmreg::timestamp_to_str(mixin.blk_timestamp)},
+                            {"mix_age"        , mixin_age.first},
+                            {"mix_mixin_no"   , mixin_tx_sum.mixin_no},
+                            {"mix_inputs_no"  , mixin_tx_sum.no_inputs},
+                            {"mix_outputs_no" , mixin_tx_sum.no_outputs},
+                            {"mix_age_format" , mixin_age.second},
+                            {"mix_idx"        , fmt::format("{:02d}", count)},
+                    });
+
+                    // get mixin timestamp from its orginal block
+                    mixin_timestamps.push_back(mixin.blk_timestamp);
+
+                    ++count;
+
+                } // for (const ring_member& mixin: ring_members.at(input_idx))
+
+                // get mixins in time scale for visual representation
+                pair<string, double> mixin_times_scale = xmreg::timestamps_time_scale(
+                                                            mixin_timestamps,
+                                                            server_timestamp, 170);
+
+                // save resolution of mixin timescales
+                timescale_scale = mixin_times_scale.second;
+
+                // save the string timescales for later to show
+                mixins_timescales.push_back(mstch::map {
+                    {"timescale", mixin_times_scale.first}});
+
+                input_idx++;
+            } // for (const txin_to_key& in_key: txd.input_key_imgs)
+
+            context["server_time"]      = server_time_str;
+            context["inputs"]           = inputs;
+            context["timescales"]       = mixins_timescales;
+            context["timescales_scale"] = fmt::format("{:0.2f}",
+                                                timescale_scale / 3600.0 / 24.0); // in days
+
+            // get indices of outputs in amounts tables
+            vector<uint64_t> out_amount_indices;
+
+            try
+            {
+
+                uint64_t tx_index;
+
+                if (core_storage->get_db().tx_exists(txd.hash, tx_index))
+                {
+                    out_amount_indices = core_storage->get_db()
+                            .get_tx_amount_output_indices(tx_index);
+                }
+                else
+                {
+                    cerr << "get_tx_outputs_gindexs failed to find transaction with id = " << txd.hash;
+                }
+
+            }
+            catch(const exception& e)
+            {
+                cerr << e.what() << endl;
+            }
+
+            uint64_t output_idx {0};
+
+            mstch::array outputs;
+
+            for (pair<txout_to_key, uint64_t>& outp: txd.output_pub_keys)
+            {
+
+                // total number of ouputs in the blockchain for this amount
+                uint64_t num_outputs_amount = core_storage->get_db()
+                                                .get_num_outputs(outp.second);
+
+                string out_amount_index_str {"N/A"};
+
+                // outputs in tx in them mempool dont have yet global indices
+                // thus for them, we print N/A
+                if (!out_amount_indices.empty())
+                {
+                    out_amount_index_str = fmt::format("{:d}",
+                                            out_amount_indices.at(output_idx));
+                }
+
+                outputs.push_back(mstch::map {
+                      {"out_pub_key"   , REMOVE_HASH_BRAKETS(fmt::format("{:s}", outp.first.key))},
+                      {"amount"        , fmt::format("{:0.12f}", XMR_AMOUNT(outp.second))},
+                      {"amount_idx"    , out_amount_index_str},
+                      {"num_outputs"   , fmt::format("{:d}", num_outputs_amount)},
+                      {"output_idx"    , fmt::format("{:02d}", output_idx++)}
+                });
+            }
+
+            context["outputs"] = outputs;
+
+            // get compiled tx.html with header and footer
+            shared_ptr<const mstch::compiled_template> full_page
+                    = templates.get_compiled(TMPL_TX);
+
+            // render the page
+            string html = mstch::render(*full_page, context);
+
+            if (use_cache && tx_blk_found && is_page_cacheable(tx_blk_height))
+            {
+                rendered_pages.put(cache_key,
+                                   rendered_page {html, server_timestamp},
+                                   html.size());
+            }
+
+            return fill_ages(html, server_timestamp);
+        }
+
+
+        string
+        get_search_status(string uuid)
+        {
+
+            // check if we have a search thread with given uuid
+            shared_ptr<xmreg::search_class_test> search_cls
+                    = get_searching_thread(uuid);
+
+            // if not such thread
+            if (!search_cls)
+            {
+                return "No search thread found for this uuid: " + uuid;
+            }
+
+
+            search_cls->last_accessed = std::time(nullptr);
+
+            // position of the search in the queue, if its not started yet
+            size_t queue_position = searches.queue_position(search_cls.get());
+
+            // outputs are copied, as the search thread can
+            // still be adding new ones to them
+            mstch::array found_outputs = search_cls->get_outputs();
+
+            uint64_t block_id         = search_cls->block_id;
+            string timestamp_str      = search_cls->get_timestamp_str();
+            uint64_t blk_chain_height = search_cls->current_blockchain_height;
+            uint64_t no_outputs_found = found_outputs.size();
+            string xmr_address_str    = search_cls->xmr_address_str;
+            string xmr_viewkey_str    = search_cls->viewkey_str;
+            bool search_finished      = search_cls->search_finished;
+
+            mstch::map context {
+                    {"block_id"             , block_id},
+                    {"blk_chain_height"     , blk_chain_height},
+                    {"current_blk_timestamp", timestamp_str},
+                    {"txs_found"            , mstch::array{}},
+                    {"no_outputs_found"     , no_outputs_found},
+                    {"xmr_address"          , xmr_address_str},
+                    {"xmr_viewkey"          , xmr_viewkey_str},
+                    {"refresh"              , !search_finished},
+                    {"search_finished"      , search_finished},
+                    {"in_queue"             , queue_position > 0},
+                    {"queue_position"       , std::to_string(queue_position)},
+                    {"uuid"                 , uuid}
+            };
+
+            uint64_t sum_xmr {0};
+
+            string tx_hash {""};
+
+            // for each output found
+            for (mstch::node& output: found_outputs)
+            {
+                mstch::map& output_map = boost::get<mstch::map>(output);
+
+                uint64_t amount = boost::get<uint64_t>(output_map["amount"]);
+                string current_tx_hash = boost::get<string>(output_map["tx_hash"]);
+
+                output_map["amount_str"] = fmt::format("{:0.12f}", XMR_AMOUNT(amount));
+
+                output_map["same_tx"]    = (tx_hash != current_tx_hash);
+
+                if (tx_hash != current_tx_hash)
+                    tx_hash = current_tx_hash;
+
+                boost::get<mstch::array>(
+                        context["txs_found"]).push_back(output_map);
+
+                sum_xmr += amount;
+            }
+
+            context.insert(
+                    {"sum_xmr", fmt::format("{:0.12f}", XMR_AMOUNT(sum_xmr))}
+            );
+
+            // get compiled txs_found.html with header, footer
+            // and its partials
+            shared_ptr<const mstch::compiled_template> full_page
+                    = templates.get_compiled(TMPL_TXS_FOUND);
+
+            // render the page
+            return mstch::render(*full_page, context);
+
+        };
+
+        string
+        fire_finish_search(string uuid)
+        {
+            shared_ptr<xmreg::search_class_test> search_cls
+                    = get_searching_thread(uuid);
+
+            if (!search_cls)
+            {
+                return "No search thread found for this uuid: " + uuid;
+            }
+
+            search_cls->user_left = true;
+            //searching_threads.erase(uuid);
+            cout <<  "User left" << endl;
+            return {};
+        };
+
+
+        string
+        show_my_outputs(string xmr_address_str,
+                        string viewkey_str,
+                        string uuid,
+                        uint64_t since_when = 1)
+        {
+            // remove white characters
+            boost::trim(xmr_address_str);
+            boost::trim(viewkey_str);
+
+            if (xmr_address_str.empty())
+            {
+                return string("Monero address not provided!");
+            }
+
+            if (viewkey_str.empty())
+            {
+                return string("Viewkey not provided!");
+            }
+
+            // parse string representing given monero address
+            cryptonote::account_public_address address;
+
+            if (!xmreg::parse_str_address(xmr_address_str,  address, 0))
+            {
+                cerr << "Cant parse string address: " << xmr_address_str << endl;
+                return string("Cant parse xmr address: " + xmr_address_str);
+            }
+
+            // parse string representing given private viewkey
+            crypto::secret_key prv_view_key;
+
+            if (!xmreg::parse_str_secret_key(viewkey_str, prv_view_key))
+            {
+                cerr << "Cant parse view key: " << viewkey_str << endl;
+                return string("Cant parse view key: " + viewkey_str);
+            }
+
+            // get the current blockchain height.
+            uint64_t height = mcore->get_current_blockchain_height() - 1;
+
+            uint64_t out_idx = {0};
+
+            mstch::map context {
+                {"xmr_address"  , xmr_address_str},
+                {"viewkey"      , viewkey_str},
+                {"uuid"         , uuid},
+                {"refresh"      , true}
+            };
+
+            mstch::array outputs;
+
+            shared_ptr<xmreg::search_class_test> search_cls
+                    = get_searching_thread(uuid);
+
+            if (!search_cls)
+            {
+                return "No search thread found for this uuid: " + uuid;
+            }
+
+            // e.g., since_when not one of the allowed values
+            if (!search_cls->keys_parsed)
+            {
+                std::lock_guard<std::mutex> lock(searching_threads_mutex);
+                searching_threads.erase(uuid);
+
+                return string("Incorrect search parameters.");
+            }
+
+            // the scheduler keeps its own copy of the shared_ptr, so
+            // the search object outlives it even if removed from the map
+            if (!searches.submit(search_cls))
+            {
+                std::lock_guard<std::mutex> lock(searching_threads_mutex);
+                searching_threads.erase(uuid);
+
+                return string("Too many searches at the moment. Please try again later.");
+            }
+
+            // render the page
+            //return mstch::render(*templates.get(TMPL_REDIRECT), context);
+            return get_search_status(uuid);
+        }
+
+        string
+        show_my_tx_outputs(string tx_hash_str,
+                           string xmr_address_str,
+                           string viewkey_str)
+        {
+            //get current server timestamp
+            time_t server_timestamp = std::time(nullptr);
+
+            // remove white characters
+            boost::trim(tx_hash_str);
+            boost::trim(xmr_address_str);
+            boost::trim(viewkey_str);
+
+            if (tx_hash_str.empty())
+            {
+                return string("tx hash not provided!");
+            }
+
+            if (xmr_address_str.empty())
+            {
+                return string("Monero address not provided!");
+            }
+
+            if (viewkey_str.empty())
+            {
+                return string("Viewkey not provided!");
+            }
+
+            // parse tx hash string to hash object
+            crypto::hash tx_hash;
+
+            if (!xmreg::parse_str_secret_key(tx_hash_str, tx_hash))
+            {
+                cerr << "Cant parse tx hash: " << tx_hash_str << endl;
+                return string("Cant get tx hash due to parse error: " + tx_hash_str);
+            }
+
+            // parse string representing given monero address
+            cryptonote::account_public_address address;
+
+            if (!xmreg::parse_str_address(xmr_address_str,  address, 0))
+            {
+                cerr << "Cant parse string address: " << xmr_address_str << endl;
+                return string("Cant parse xmr address: " + xmr_address_str);
+            }
+
+            // parse string representing given private viewkey
+            crypto::secret_key prv_view_key;
+
+            if (!xmreg::parse_str_secret_key(viewkey_str, prv_view_key))
+            {
+                cerr << "Cant parse view key: " << viewkey_str << endl;
+                return string("Cant parse view key: " + viewkey_str);
+            }
+
+
+            // tx age
+            pair<string, string> age;
+
+            string blk_timestamp {"N/A"};
+
+            // get transaction
+            transaction tx;
+
+            if (!mcore->get_tx(tx_hash, tx))
+            {
+                cerr << "Cant get tx in blockchain: " << tx_hash
+                     << ". \n Check mempool now" << endl;
+
+                vector<pair<tx_info, transaction>> found_txs
+                        = search_mempool(tx_hash);
+
+                if (!found_txs.empty())
+                {
+                    // there should be only one tx found
+                    tx = found_txs.at(0).second;
+
+                    // since its tx in mempool, it has no blk yet
+                    // so use its recive_time as timestamp to show
+
+                    uint64_t tx_recieve_timestamp
+                            = found_txs.at(0).first.receive_time;
+
+                    blk_timestamp = xmreg::timestamp_to_str(tx_recieve_timestamp);
+
+                    age = get_age(server_timestamp, tx_recieve_timestamp,
+                                  FULL_AGE_FORMAT);
+                }
+                else
+                {
+                    // tx is nowhere to be found :-(
+                    return string("Cant get tx: " + tx_hash_str);
+                }
+            }
+
+            tx_details txd = get_tx_details(tx);
+
+            uint64_t tx_blk_height {0};
+
+            bool tx_blk_found {false};
+
+            try
+            {
+                tx_blk_height = core_storage->get_db().get_tx_block_height(tx_hash);
+                tx_blk_found = true;
+            }
+            catch (exception& e)
+            {
+                cerr << "Cant get block height: " << tx_hash
+                     << e.what() << endl;
+            }
+
+
+            // get block cointaining this tx
+            block blk;
+
+            if (tx_blk_found && !mcore->get_block_by_height(tx_blk_height, blk))
+            {
+                cerr << "Cant get block: " << tx_blk_height << endl;
+            }
+
+            string tx_blk_height_str {"N/A"};
+
+            if (tx_blk_found)
+            {
+                // calculate difference between tx and server timestamps
+                age = get_age(server_timestamp, blk.timestamp, FULL_AGE_FORMAT);
+
+                blk_timestamp = xmreg::timestamp_to_str(blk.timestamp);
+
+                tx_blk_height_str = std::to_string(tx_blk_height);
+            }
+
+            // payments id. both normal and encrypted (payment_id8)
+            string pid_str   = REMOVE_HASH_BRAKETS(fmt::format("{:s}", txd.payment_id));
+            string pid8_str  = REMOVE_HASH_BRAKETS(fmt::format("{:s}", txd.payment_id8));
+
+            // initalise page tempate map with basic info about blockchain
+            mstch::map context {
+                    {"tx_hash"              , tx_hash_str},
+                    {"xmr_address"          , xmr_address_str},
+                    {"viewkey"              , viewkey_str},
+                    {"tx_pub_key"           , REMOVE_HASH_BRAKETS(fmt::format("{:s}", txd.pk))},
+                    {"blk_height"           , tx_blk_height_str},
+                    {"tx_size"              , fmt::format("{:0.4f}",
+                                                          static_cast<double>(txd.size) / 1024.0)},
+                    {"tx_fee"               , fmt::format("{:0.12f}", XMR_AMOUNT(txd.fee))},
+                    {"blk_timestamp"        , blk_timestamp},
+                    {"delta_time"           , age.first},
+                    {"outputs_no"           , txd.output_pub_keys.size()},
+                    {"has_payment_id"       , txd.payment_id  != null_hash},
+                    {"has_payment_id8"      , txd.payment_id8 != null_hash8},
+                    {"payment_id"           , pid_str},
+                    {"payment_id8"          , pid8_str}
+            };
+
+            string server_time_str = xmreg::timestamp_to_str(server_timestamp, "%F");
+
+            uint64_t output_idx {0};
+
+            // public transaction key is combined with our viewkey
+            // to create, so called, derived key.
+            key_derivation derivation;
+
+            if (!generate_key_derivation(txd.pk, prv_view_key, derivation))
+            {
+                cerr << "Cant get dervied key for: "  << "\n"
+                     << "pub_tx_key: " << txd.pk << " and "
+                     << "prv_view_key" << prv_view_key << endl;
+
+                return string("Cant get key_derivation");
+            }
+
+
+            mstch::array outputs;
+
+            uint64_t sum_xmr {0};
+
+
+            for (pair<txout_to_key, uint64_t>& outp: txd.output_pub_keys)
+            {
+
+                // get the tx output public key
+                // that normally would be generated for us,
+                // if someone had sent us some xmr.
+                public_key pubkey;
+
+                derive_public_key(derivation,
+                                  output_idx,
+                                  address.m_spend_public_key,
+                                  pubkey);
+
+                // check if generated public key matches the current output's key
+                bool mine_output = (outp.first.key == pubkey);
+
+                if (mine_output)
+                {
                     sum_xmr += outp.second;
                 }
 
-                outputs.push_back(mstch::map {
-                        {"out_pub_key"   , REMOVE_HASH_BRAKETS(fmt::format("{:s}", outp.first.key))},
-                        {"amount"        , fmt::format("{:0.12f}", XMR_AMOUNT(outp.second))},
-                        {"mine_output"   , mine_output},
-                        {"output_idx"    , fmt::format("{:02d}", output_idx++)}
-                });
+                outputs.push_back(mstch::map {
+                        {"out_pub_key"   , REMOVE_HASH_BRAKETS(fmt::format("{:s}", outp.first.key))},
+                        {"amount"        , fmt::format("{:0.12f}", XMR_AMOUNT(outp.second))},
+                        {"mine_output"   , mine_output},
+                        {"output_idx"    , fmt::format("{:02d}", output_idx++)}
+                });
+
+            }
+
+            cout << "outputs.size(): " << outputs.size() << endl;
+
+            context["outputs"] = outputs;
+            context["sum_xmr"] = XMR_AMOUNT(sum_xmr);
+
+            // get my_tx_outputs.html with header and footer
+            shared_ptr<const string> full_page = get_full_page(TMPL_MY_TX_OUTPUTS);
+
+            // render the page
+            return mstch::render(*full_page, context);
+        }
+
+
+        string
+        search(string search_text, uint64_t page_no = 0)
+        {
+
+            // remove white characters
+            boost::trim(search_text);
+
+            string default_txt {"No such thing found: " + search_text};
+
+            string result_html {default_txt};
+
+            // check first if we look for output with given global index
+            // such search start with "goi_", e.g., "goi_543"
+            bool search_for_global_output_idx = (search_text.substr(0, 4) == "goi_");
+
+            // check if we look for output with amout index and amount
+            // such search start with "aoi_", e.g., "aoi_444-23.00"
+            bool search_for_amount_output_idx = (search_text.substr(0, 4) == "aoi_");
+
+            // first check if searching for block of given height
+            if (search_text.size() < 12 &&
+                                (search_for_global_output_idx == false
+                                 ||search_for_amount_output_idx == false))
+            {
+                uint64_t blk_height;
+
+                try
+                {
+                    blk_height = boost::lexical_cast<uint64_t>(search_text);
+
+                    result_html = show_block(blk_height);
+
+                    // nasty check if output is "Cant get" as a sign of
+                    // a not found tx. Later need to think of something better.
+                    if (result_html.find("Cant get") == string::npos)
+                    {
+                         return result_html;
+                    }
+
+                }
+                catch(boost::bad_lexical_cast &e)
+                {
+                    // not a number, so it can still be
+                    // a hex prefix of a hash or a key
+                    if (!is_search_prefix(search_text))
+                    {
+                        return result_html;
+                    }
+                }
+
+            }
+
+            // if the key index of the custom lmdb is up to date, one lookup
+            // tells what a given hash or key is, so there is no need to
+            // try all the possibilities below one after another
+            if (!search_for_global_output_idx && !search_for_amount_output_idx
+                && is_key_index_ready())
+            {
+                return search_key_index(search_text, page_no);
+            }
+
+            // second let try searching for tx
+            result_html = show_tx(search_text);
+
+            // nasty check if output is "Cant get" as a sign of
+            // a not found tx. Later need to think of something better.
+            if (result_html.find("Cant get") == string::npos)
+            {
+                 return result_html;
+            }
+
+            // if tx search not successful, check if we are looking
+            // for a block with given hash
+            result_html = show_block(search_text);
+
+            if (result_html.find("Cant get") == string::npos)
+            {
+                 return result_html;
+            }
+
+            result_html = default_txt;
+
+            // get mempool transaction so that what we search,
+            // might be there. Note: show_tx above already searches it
+            // but only looks for tx hash. Now want to check
+            // for key_images, public_keys, payments_id, etc.
+            vector<transaction> mempool_txs = get_mempool_txs();
+
+            // key is string indicating where search_text was found.
+            map<string, vector<string>> tx_search_results
+                                = search_txs(mempool_txs, search_text);
+
+            // now search my own custom lmdb database
+            // with key_images, public_keys, payments_id etc.
+
+            vector<pair<string, vector<string>>> all_possible_tx_hashes;
+
+
+
+
+            try
+            {
+                if (!mylmdb)
+                {
+                    throw std::runtime_error("custom lmdb database does not exist");
+                }
+
+                mylmdb->search(search_text,
+                               tx_search_results["key_images"],
+                               "key_images");
+
+                cout << "size: " << tx_search_results["key_images"].size() << endl;
+
+                all_possible_tx_hashes.push_back(
+                        make_pair("key_images",
+                                  tx_search_results["key_images"]));
+
+
+                // search the custum lmdb for tx_public_keys and append the result
+                // to those from the mempool search if found
+
+                mylmdb->search(search_text,
+                               tx_search_results["tx_public_keys"],
+                               "tx_public_keys");
+
+                all_possible_tx_hashes.push_back(
+                        make_pair("tx_public_keys",
+                                  tx_search_results["tx_public_keys"]));
+
+                // search the custum lmdb for payments_id and append the result
+                // to those from the mempool search if found
+
+                mylmdb->search(search_text,
+                               tx_search_results["payments_id"],
+                               "payments_id");
+
+                all_possible_tx_hashes.push_back(
+                        make_pair("payments_id",
+                                  tx_search_results["payments_id"]));
+
+                // search the custum lmdb for encrypted_payments_id and append the result
+                // to those from the mempool search if found
+
+                mylmdb->search(search_text,
+                               tx_search_results["encrypted_payments_id"],
+                               "encrypted_payments_id");
+
+                all_possible_tx_hashes.push_back(
+                        make_pair("encrypted_payments_id",
+                                  tx_search_results["encrypted_payments_id"]));
+
+                // search the custum lmdb for output_public_keys and append the result
+                // to those from the mempool search if found
+
+                mylmdb->search(search_text,
+                               tx_search_results["output_public_keys"],
+                               "output_public_keys");
+
+                all_possible_tx_hashes.push_back(
+                        make_pair("output_public_keys",
+                                  tx_search_results["output_public_keys"]));
+
+
+                // seach for output using output global index
+
+                if (search_for_global_output_idx)
+                {
+                    try
+                    {
+                        uint64_t global_idx = boost::lexical_cast<uint64_t>(
+                                search_text.substr(4));
+
+
+                        //cout << "global_idx: " << global_idx << endl;
+
+                        // get info about output of a given global index
+                        output_data_t output_data = core_storage->get_db()
+                                .get_output_key(global_idx);
+
+                        //tx_out_index tx_out = core_storage->get_db()
+                        //                    .get_output_tx_and_index_from_global(global_idx);
+
+                        //cout << "tx_out.first: " << tx_out.first << endl;
+                        //cout << "tx_out.second: " << tx_out.second << endl;
+
+                        string output_pub_key = pod_to_hex(output_data.pubkey);
+
+                        //cout << "output_pub_key: " << output_pub_key << endl;
+
+                        vector<string> found_outputs;
+
+                        mylmdb->search(output_pub_key,
+                                       found_outputs,
+                                       "output_public_keys");
+
+                        //cout << "found_outputs.size(): " << found_outputs.size() << endl;
+
+                        all_possible_tx_hashes.push_back(
+                                make_pair("output_public_keys_based_on_global_idx",
+                                          found_outputs));
+
+                    }
+                    catch(boost::bad_lexical_cast &e)
+                    {
+                        cerr << "Cant cast global_idx string: "
+                        << search_text.substr(4) << endl;
+                    }
+                } //  if (search_for_global_output_idx)
+
+                // seach for output using output amount index and amount
+
+                if (search_for_amount_output_idx)
+                {
+                    try
+                    {
+
+                        string str_to_split = search_text.substr(4);
+
+                        vector<string> string_parts;
+
+                        boost::split(string_parts, str_to_split,
+                                     boost::is_any_of("-"));
+
+                        if (string_parts.size() != 2)
+                        {
+                            throw;
+                        }
+
+                        uint64_t amount_idx = boost::lexical_cast<uint64_t>(
+                                string_parts[0]);
+
+                        uint64_t amount = static_cast<uint64_t>
+                        (boost::lexical_cast<double>(
+                                        string_parts[1]) * 1e12);
+
+
+                        //cout << "amount_idx: " << amount_idx << endl;
+                        //cout << "amount: "     << amount << endl;
 
-            }
+                        // get info about output of a given global index
+                        output_data_t output_data = core_storage->get_db()
+                                .get_output_key(
+                                        amount, amount_idx);
 
-            cout << "outputs.size(): " << outputs.size() << endl;
+                        string output_pub_key = pod_to_hex(output_data.pubkey);
 
-            context["outputs"] = outputs;
-            context["sum_xmr"] = XMR_AMOUNT(sum_xmr);
+                        //cout << "output_pub_key: " << output_pub_key << endl;
 
-            // read my_outputs.html
-            string my_outputs_html = xmreg::read(TMPL_MY_TX_OUTPUTS);
+                        vector<string> found_outputs;
 
-            // add header and footer
-            string full_page = get_full_page(my_outputs_html);
+                        mylmdb->search(output_pub_key,
+                                       found_outputs,
+                                       "output_public_keys");
 
-            // render the page
-            return mstch::render(full_page, context);
+                        //cout << "found_outputs.size(): " << found_outputs.size() << endl;
+
+                        all_possible_tx_hashes.push_back(
+                                make_pair("output_public_keys_based_on_amount_idx",
+                                          found_outputs));
+
+                    }
+                    catch(boost::bad_lexical_cast& e)
+                    {
+                        cerr << "Cant parse amout index and amout string: "
+                             << search_text.substr(4) << endl;
+                    }
+                    catch(OUTPUT_DNE& e)
+                    {
+                        cerr << "Output not found in the blockchain: "
+                             << search_text.substr(4) << endl;
+
+                        return(string("Output not found in the blockchain: ")
+                               + search_text.substr(4));
+                    }
+                } // if (search_for_amount_output_idx)
+            }
+            catch (const lmdb::runtime_error& e)
+            {
+                cerr << "Error opening/accessing custom lmdb database: "
+                     << e.what() << endl;
+            }
+            catch (std::exception& e)
+            {
+                cerr << "Error opening/accessing custom lmdb database: "
+                     << e.what() << endl;
+            }
+
+
+
+            result_html = show_search_results(search_text, all_possible_tx_hashes);
+
+            return result_html;
         }
 
 
+        /**
+         * Search for 32 byte hashes and keys, or 8 byte encrypted
+         * payment ids, using the key index of the custom lmdb.
+         */
         string
-        search(string search_text)
+        search_key_index(const string& search_text, uint64_t page_no = 0)
         {
+            crypto::hash key;
 
-            // remove white characters
-            boost::trim(search_text);
-
-            string default_txt {"No such thing found: " + search_text};
+            if (!parse_search_key(search_text, key))
+            {
+                if (is_search_prefix(search_text))
+                {
+                    return search_prefix(search_text, page_no);
+                }
 
-            string result_html {default_txt};
+                return show_search_results(search_text, {});
+            }
 
-            // check first if we look for output with given global index
-            // such search start with "goi_", e.g., "goi_543"
-            bool search_for_global_output_idx = (search_text.substr(0, 4) == "goi_");
+            vector<key_index_entry> entries;
 
-            // check if we look for output with amout index and amount
-            // such search start with "aoi_", e.g., "aoi_444-23.00"
-            bool search_for_amount_output_idx = (search_text.substr(0, 4) == "aoi_");
+            mylmdb->get_key_index(key, entries);
 
-            // first check if searching for block of given height
-            if (search_text.size() < 12 &&
-                                (search_for_global_output_idx == false
-                                 ||search_for_amount_output_idx == false))
+            // txs and blocks have their own pages
+            for (const key_index_entry& entry: entries)
             {
-                uint64_t blk_height;
+                if (entry.kind == KEY_TX_HASH)
+                {
+                    return show_tx(search_text);
+                }
 
-                try
+                if (entry.kind == KEY_BLOCK_HASH)
                 {
-                    blk_height = boost::lexical_cast<uint64_t>(search_text);
+                    return show_block(entry.blk_height);
+                }
+            }
 
-                    result_html = show_block(blk_height);
+            if (entries.empty())
+            {
+                shared_ptr<const mempool_snapshot> mempool = mempool_status.get_snapshot();
 
-                    // nasty check if output is "Cant get" as a sign of
-                    // a not found tx. Later need to think of something better.
-                    if (result_html.find("Cant get") == string::npos)
-                    {
-                         return result_html;
-                    }
+                if (mempool->tx_index.count(key))
+                {
+                    return show_tx(search_text);
+                }
 
+                // the key index can be behind the blockchain,
+                // so check the most recent txs and blocks too
+                if (core_storage->get_db().tx_exists(key))
+                {
+                    return show_tx(search_text);
                 }
-                catch(boost::bad_lexical_cast &e)
+
+                if (core_storage->get_db().block_exists(key))
                 {
-                    return result_html;
+                    return show_block(search_text);
                 }
+            }
+
+            // key images, public keys and payment ids can also
+            // be in the mempool
+            map<string, vector<string>> tx_search_results
+                    = search_txs(get_mempool_txs(), search_text);
 
+            // blocks written to the tables by an external tool
+            // are not in the key index, so look in the tables too
+            if (entries.empty())
+            {
+                for (const string& table: {"key_images", "tx_public_keys", "payments_id",
+                                           "encrypted_payments_id", "output_public_keys"})
+                {
+                    mylmdb->search(search_text, tx_search_results[table], table);
+                }
             }
 
-            // second let try searching for tx
-            result_html = show_tx(search_text);
+            for (const key_index_entry& entry: entries)
+            {
+                tx_search_results[key_kind_to_str(entry.kind)]
+                        .push_back(pod_to_hex(entry.tx_hash));
+            }
 
-            // nasty check if output is "Cant get" as a sign of
-            // a not found tx. Later need to think of something better.
-            if (result_html.find("Cant get") == string::npos)
+            bool nothing_found = std::all_of(
+                    tx_search_results.begin(), tx_search_results.end(),
+                    [](const pair<const string, vector<string>>& result)
+                    {
+                        return result.second.empty();
+                    });
+
+            // 16 hex characters can be either encrypted
+            // payment id or beginning of a hash
+            if (nothing_found && is_search_prefix(search_text))
             {
-                 return result_html;
+                return search_prefix(search_text, page_no);
             }
 
-            // if tx search not successful, check if we are looking
-            // for a block with given hash
-            result_html = show_block(search_text);
+            vector<pair<string, vector<string>>> all_possible_tx_hashes;
 
-            if (result_html.find("Cant get") == string::npos)
+            for (const string& kind: {"key_images", "tx_public_keys", "payments_id",
+                                      "encrypted_payments_id", "output_public_keys"})
             {
-                 return result_html;
+                all_possible_tx_hashes.push_back(
+                        make_pair(kind, tx_search_results[kind]));
             }
 
-            result_html = default_txt;
+            return show_search_results(search_text, all_possible_tx_hashes);
+        }
 
-            // get mempool transaction so that what we search,
-            // might be there. Note: show_tx above already searches it
-            // but only looks for tx hash. Now want to check
-            // for key_images, public_keys, payments_id, etc.
-            vector<transaction> mempool_txs = get_mempool_txs();
+        /**
+         * True if all blocks, except the few most recent ones
+         * checked directly in the blockchain, are in the key index.
+         * While the index is catching up, it cant be used.
+         */
+        bool
+        is_key_index_ready()
+        {
+            if (!mylmdb)
+            {
+                return false;
+            }
 
-            // key is string indicating where search_text was found.
-            map<string, vector<string>> tx_search_results
-                                = search_txs(mempool_txs, search_text);
+            uint64_t indexed_height;
+            bool     has_indexed;
 
-            // now search my own custom lmdb database
-            // with key_images, public_keys, payments_id etc.
+            if (!mylmdb->get_indexed_height(indexed_height, has_indexed)
+                || !has_indexed)
+            {
+                return false;
+            }
 
-            vector<pair<string, vector<string>>> all_possible_tx_hashes;
+            return indexed_height + MicroCore::CACHE_REORG_DEPTH
+                   >= mcore->get_current_blockchain_height();
+        }
+
+        bool
+        is_search_prefix(const string& search_text)
+        {
+            return search_text.size() >= MIN_SEARCH_PREFIX_LENGTH
+                   && search_text.size() < sizeof(crypto::hash) * 2
+                   && std::all_of(search_text.begin(), search_text.end(),
+                                  [](char c) { return std::isxdigit(static_cast<unsigned char>(c)); });
+        }
+
+        /**
+         * Show hashes and keys from the key index that
+         * start with a given hex string, one page at a time.
+         */
+        string
+        search_prefix(const string& prefix, uint64_t page_no)
+        {
+            page_no = std::min(page_no, MAX_SEARCH_PREFIX_PAGES - 1);
 
+            vector<pair<crypto::hash, key_index_entry>> found;
 
+            bool has_more {false};
 
+            mylmdb->search_key_index_prefix(prefix,
+                                            page_no * SEARCH_PREFIX_RESULTS_PER_PAGE,
+                                            SEARCH_PREFIX_RESULTS_PER_PAGE,
+                                            found, has_more);
 
-            try
+            mstch::array matches;
+
+            for (const auto& match: found)
+            {
+                const key_index_entry& entry = match.second;
+
+                string key_str = pod_to_hex(match.first);
+
+                // encrypted payment ids are padded with zeros in the index
+                if (entry.kind == KEY_ENCRYPTED_PAYMENT_ID)
+                {
+                    key_str = key_str.substr(0, sizeof(crypto::hash8) * 2);
+                }
+
+                matches.push_back(mstch::map {
+                        {"key"       , key_str},
+                        {"kind"      , key_kind_to_str(entry.kind)},
+                        {"is_block"  , entry.kind == KEY_BLOCK_HASH},
+                        {"blk_height", entry.blk_height},
+                        {"tx_hash"   , pod_to_hex(entry.tx_hash)}
+                });
+            }
+
+            mstch::map context {
+                    {"search_text"  , prefix},
+                    {"no_results"   , matches.empty()},
+                    {"matches"      , matches},
+                    {"has_prev_page", page_no > 0},
+                    {"prev_page"    , page_no > 0 ? page_no - 1 : 0},
+                    {"has_next_page", has_more && page_no + 1 < MAX_SEARCH_PREFIX_PAGES},
+                    {"next_page"    , page_no + 1}
+            };
+
+            shared_ptr<const string> full_page = get_full_page(TMPL_SEARCH_PREFIX);
+
+            return mstch::render(*full_page, context);
+        }
+
+        /**
+         * Parse hex string of 32 bytes, or 8 bytes in case of
+         * encrypted payment ids, into a key of the key index.
+         */
+        bool
+        parse_search_key(const string& search_text, crypto::hash& key)
+        {
+            if (search_text.size() == sizeof(crypto::hash8) * 2)
+            {
+                crypto::hash8 payment_id8;
+
+                if (!hex_to_pod(search_text, payment_id8))
+                {
+                    return false;
+                }
+
+                key = to_index_key(payment_id8);
+
+                return true;
+            }
+
+            return hex_to_pod(search_text, key);
+        }
+
+        map<string, vector<string>>
+        search_txs(vector<transaction> txs, const string& search_text)
+        {
+            map<string, vector<string>> tx_hashes;
+
+            // initlizte the map with empty results
+            tx_hashes["key_images"]                             = {};
+            tx_hashes["tx_public_keys"]                         = {};
+            tx_hashes["payments_id"]                            = {};
+            tx_hashes["encrypted_payments_id"]                  = {};
+            tx_hashes["output_public_keys"]                     = {};
+
+            for (const transaction& tx: txs)
             {
-                unique_ptr<xmreg::MyLMDB> mylmdb;
 
-                if (!bf::is_directory(lmdb2_path))
+                tx_details txd = get_tx_details(tx);
+
+                string tx_hash_str = pod_to_hex(txd.hash);
+
+                // check if any key_image matches the search_text
+
+                vector<txin_to_key>::iterator it1 =
+                    find_if(begin(txd.input_key_imgs), end(txd.input_key_imgs),
+                        [&](const txin_to_key& key_img)
+                        {
+                            return pod_to_hex(key_img.k_image) == search_text;
+                        });
+
+                if (it1 != txd.input_key_imgs.end())
+                {
+                    tx_hashes["key_images"].push_back(tx_hash_str);
+                }
+
+                // check if  tx_public_key matches the search_text
+
+                if (pod_to_hex(txd.pk) == search_text)
+                {
+                    tx_hashes["tx_public_keys"].push_back(tx_hash_str);
+                }
+
+                // check if  payments_id matches the search_text
+
+                if (pod_to_hex(txd.payment_id) == search_text)
+                {
+                    tx_hashes["payment_id"].push_back(tx_hash_str);
+                }
+
+                // check if  encrypted_payments_id matches the search_text
+
+                if (pod_to_hex(txd.payment_id8) == search_text)
+                {
+                    tx_hashes["encrypted_payments_id"].push_back(tx_hash_str);
+                }
+
+                // check if output_public_keys matche the search_text
+
+                vector<pair<txout_to_key, uint64_t>>::iterator it2 =
+                    find_if(begin(txd.output_pub_keys), end(txd.output_pub_keys),
+                        [&](const pair<txout_to_key, uint64_t>& tx_out_pk)
+                        {
+                            return pod_to_hex(tx_out_pk.first.key) == search_text;
+                        });
+
+                if (it2 != txd.output_pub_keys.end())
                 {
-                    throw std::runtime_error(lmdb2_path + " does not exist");
+                    tx_hashes["output_public_keys"].push_back(tx_hash_str);
                 }
 
-                cout << "Custom lmdb database seem to exist at: " << lmdb2_path << endl;
-                cout << "So lets try to search there for what we are after." << endl;
+            }
+
+            return  tx_hashes;
+
+        }
 
-                mylmdb = make_unique<xmreg::MyLMDB>(lmdb2_path);
+        vector<transaction>
+        get_mempool_txs()
+        {
+            // get current snapshot of the mempool
+            shared_ptr<const mempool_snapshot> mempool = mempool_status.get_snapshot();
 
+            // output only transactions
+            vector<transaction> mempool_txs;
 
-                mylmdb->search(search_text,
-                               tx_search_results["key_images"],
-                               "key_images");
+            mempool_txs.reserve(mempool->txs.size());
 
-                cout << "size: " << tx_search_results["key_images"].size() << endl;
+            for (const auto& a_pair: mempool->txs)
+            {
+                mempool_txs.push_back(a_pair.second);
+            }
 
-                all_possible_tx_hashes.push_back(
-                        make_pair("key_images",
-                                  tx_search_results["key_images"]));
+            return mempool_txs;
+        }
 
+        string
+        show_search_results(const string& search_text,
+            const vector<pair<string, vector<string>>>& all_possible_tx_hashes)
+        {
 
-                // search the custum lmdb for tx_public_keys and append the result
-                // to those from the mempool search if found
+            // initalise page tempate map with basic info about blockchain
+            mstch::map context {
+                    {"search_text"    , search_text},
+                    {"no_results"     , true},
+                    {"to_many_results", false}
+            };
 
-                mylmdb->search(search_text,
-                               tx_search_results["tx_public_keys"],
-                               "tx_public_keys");
+            for (const pair<string, vector<string>>& found_txs: all_possible_tx_hashes)
+            {
+                // define flag, e.g., has_key_images denoting that
+                // tx hashes for key_image searched were found
+                context.insert({"has_" + found_txs.first, !found_txs.second.empty()});
 
-                all_possible_tx_hashes.push_back(
-                        make_pair("tx_public_keys",
-                                  tx_search_results["tx_public_keys"]));
+                cout << "found_txs.first: " << found_txs.first << endl;
 
-                // search the custum lmdb for payments_id and append the result
-                // to those from the mempool search if found
+                // insert new array based on what we found to context if not exist
+                pair< mstch::map::iterator, bool> res
+                        = context.insert({found_txs.first, mstch::array{}});
 
-                mylmdb->search(search_text,
-                               tx_search_results["payments_id"],
-                               "payments_id");
+                if (!found_txs.second.empty())
+                {
 
-                all_possible_tx_hashes.push_back(
-                        make_pair("payments_id",
-                                  tx_search_results["payments_id"]));
+                    uint64_t tx_i {0};
 
-                // search the custum lmdb for encrypted_payments_id and append the result
-                // to those from the mempool search if found
+                    // dont show more than 500 results
+                    size_t no_of_txs = std::min<size_t>(found_txs.second.size(), 502);
 
-                mylmdb->search(search_text,
-                               tx_search_results["encrypted_payments_id"],
-                               "encrypted_payments_id");
+                    vector<crypto::hash> tx_hashes_pod(no_of_txs);
 
-                all_possible_tx_hashes.push_back(
-                        make_pair("encrypted_payments_id",
-                                  tx_search_results["encrypted_payments_id"]));
+                    for (size_t i = 0; i < no_of_txs; ++i)
+                    {
+                        epee::string_tools::hex_to_pod(found_txs.second[i],
+                                                       tx_hashes_pod[i]);
+                    }
 
-                // search the custum lmdb for output_public_keys and append the result
-                // to those from the mempool search if found
+                    // first check in the blockchain, getting all txs at once
+                    vector<transaction> blockchain_txs;
+                    vector<crypto::hash> missed_txs;
 
-                mylmdb->search(search_text,
-                               tx_search_results["output_public_keys"],
-                               "output_public_keys");
+                    mcore->get_txs(tx_hashes_pod, blockchain_txs, missed_txs);
 
-                all_possible_tx_hashes.push_back(
-                        make_pair("output_public_keys",
-                                  tx_search_results["output_public_keys"]));
+                    unordered_set<crypto::hash> missed_txs_set(missed_txs.begin(),
+                                                               missed_txs.end());
 
+                    // found txs are in the order of tx_hashes_pod
+                    vector<transaction>::iterator blockchain_tx = blockchain_txs.begin();
 
-                // seach for output using output global index
+                    // txs found in the blockchain or in the mempool
+                    vector<transaction> txs;
+                    vector<int64_t> blk_timestamps;
 
-                if (search_for_global_output_idx)
-                {
-                    try
+                    // for each found tx_hash, get the corresponding tx
+                    for (size_t i = 0; i < no_of_txs; ++i)
                     {
-                        uint64_t global_idx = boost::lexical_cast<uint64_t>(
-                                search_text.substr(4));
+                        const string& tx_hash = found_txs.second[i];
 
+                        const crypto::hash& tx_hash_pod = tx_hashes_pod[i];
 
-                        //cout << "global_idx: " << global_idx << endl;
+                        transaction tx;
 
-                        // get info about output of a given global index
-                        output_data_t output_data = core_storage->get_db()
-                                .get_output_key(global_idx);
+                        uint64_t blk_height {0};
 
-                        //tx_out_index tx_out = core_storage->get_db()
-                        //                    .get_output_tx_and_index_from_global(global_idx);
+                        int64_t blk_timestamp;
 
-                        //cout << "tx_out.first: " << tx_out.first << endl;
-                        //cout << "tx_out.second: " << tx_out.second << endl;
+                        if (!missed_txs_set.count(tx_hash_pod)
+                            && blockchain_tx != blockchain_txs.end())
+                        {
+                            tx = *blockchain_tx++;
 
-                        string output_pub_key = pod_to_hex(output_data.pubkey);
+                            // get timestamp of the tx's block
+                            blk_height    = core_storage
+                                    ->get_db().get_tx_block_height(tx_hash_pod);
 
-                        //cout << "output_pub_key: " << output_pub_key << endl;
+                            blk_timestamp = core_storage
+                                    ->get_db().get_block_timestamp(blk_height);
 
-                        vector<string> found_outputs;
+                        }
+                        else
+                        {
+                            // check in mempool if tx_hash not found in the
+                            // blockchain
+                            vector<pair<tx_info, transaction>> found_txs
+                                    = search_mempool(tx_hash_pod);
 
-                        mylmdb->search(output_pub_key,
-                                       found_outputs,
-                                       "output_public_keys");
+                            if (!found_txs.empty())
+                            {
+                                // there should be only one tx found
+                                tx = found_txs.at(0).second;
+                            }
+                            else
+                            {
+                                return string("Cant get tx of hash (show_search_results): " + tx_hash);
+                            }
 
-                        //cout << "found_outputs.size(): " << found_outputs.size() << endl;
+                            // tx in mempool have no blk_timestamp
+                            // but can use their recive time
+                             blk_timestamp = found_txs.at(0).first.receive_time;
 
-                        all_possible_tx_hashes.push_back(
-                                make_pair("output_public_keys_based_on_global_idx",
-                                          found_outputs));
+                        }
 
+                        txs.push_back(tx);
+                        blk_timestamps.push_back(blk_timestamp);
                     }
-                    catch(boost::bad_lexical_cast &e)
-                    {
-                        cerr << "Cant cast global_idx string: "
-                        << search_text.substr(4) << endl;
-                    }
-                } //  if (search_for_global_output_idx)
 
-                // seach for output using output amount index and amount
+                    // get details of the txs and put into mstch for rendering
+                    vector<tx_details> txs_details = get_txs_details(txs);
 
-                if (search_for_amount_output_idx)
-                {
-                    try
+                    for (size_t i = 0; i < txs_details.size(); ++i)
                     {
+                        mstch::map txd_map = txs_details[i].get_mstch_map();
 
-                        string str_to_split = search_text.substr(4);
-
-                        vector<string> string_parts;
+                        // add the timestamp to tx mstch map
+                        txd_map.insert({"timestamp", xmreg::timestamp_to_str(blk_timestamps[i])});
 
-                        boost::split(string_parts, str_to_split,
-                                     boost::is_any_of("-"));
+                        boost::get<mstch::array>((res.first)->second).push_back(txd_map);
 
-                        if (string_parts.size() != 2)
+                        // dont show more than 500 results
+                        if (tx_i > 500)
                         {
-                            throw;
+                            context["to_many_results"] = true;
+                            break;
                         }
 
-                        uint64_t amount_idx = boost::lexical_cast<uint64_t>(
-                                string_parts[0]);
-
-                        uint64_t amount = static_cast<uint64_t>
-                        (boost::lexical_cast<double>(
-                                        string_parts[1]) * 1e12);
-
+                        ++tx_i;
+                    }
 
-                        //cout << "amount_idx: " << amount_idx << endl;
-                        //cout << "amount: "     << amount << endl;
+                    // if found something, set this flag to indicate this fact
+                    context["no_results"] = false;
+                }
+            }
 
-                        // get info about output of a given global index
-                        output_data_t output_data = core_storage->get_db()
-                                .get_output_key(
-                                        amount, amount_idx);
+            // get compiled search_results.html with header, footer
+            // and partials for showing details of tx(s) found
+            shared_ptr<const mstch::compiled_template> full_page
+                    = templates.get_compiled(TMPL_SEARCH_RESULTS);
 
-                        string output_pub_key = pod_to_hex(output_data.pubkey);
+            // render the page
+            return  mstch::render(*full_page, context);
+        }
 
-                        //cout << "output_pub_key: " << output_pub_key << endl;
 
-                        vector<string> found_outputs;
 
-                        mylmdb->search(output_pub_key,
-                                       found_outputs,
-                                       "output_public_keys");
+    private:
 
-                        //cout << "found_outputs.size(): " << found_outputs.size() << endl;
+        /**
+         * Get mixins of all the given inputs in one pass.
+         *
+         * Output keys and their txs are fetched with one batched
+         * call per amount. Blocks and txs shared by many mixins
+         * are read and parsed only once, and for blocks only
+         * their timestamps are read. Txs are summarized with
+         * get_tx_summary, and the summaries are cached.
+         *
+         * ring_members[i] are mixins of inputs[i], in the
+         * order of their key offsets.
+         */
+        bool
+        resolve_ring_members(const vector<txin_to_key>& inputs,
+                             vector<vector<ring_member>>& ring_members)
+        {
+            BlockchainDB& db = core_storage->get_db();
 
-                        all_possible_tx_hashes.push_back(
-                                make_pair("output_public_keys_based_on_amount_idx",
-                                          found_outputs));
+            // absolute offsets of mixins of each input
+            vector<vector<uint64_t>> inputs_offsets;
 
-                    }
-                    catch(boost::bad_lexical_cast& e)
-                    {
-                        cerr << "Cant parse amout index and amout string: "
-                             << search_text.substr(4) << endl;
-                    }
-                    catch(OUTPUT_DNE& e)
-                    {
-                        cerr << "Output not found in the blockchain: "
-                             << search_text.substr(4) << endl;
+            // all offsets used for each amount, without duplicates
+            map<uint64_t, set<uint64_t>> amounts_offsets;
 
-                        return(string("Output not found in the blockchain: ")
-                               + search_text.substr(4));
-                    }
-                } // if (search_for_amount_output_idx)
-            }
-            catch (const lmdb::runtime_error& e)
-            {
-                cerr << "Error opening/accessing custom lmdb database: "
-                     << e.what() << endl;
-            }
-            catch (std::exception& e)
+            for (const txin_to_key& in_key: inputs)
             {
-                cerr << "Error opening/accessing custom lmdb database: "
-                     << e.what() << endl;
-            }
-
-
-
-            result_html = show_search_results(search_text, all_possible_tx_hashes);
-
-            return result_html;
-        }
+                inputs_offsets.push_back(
+                        cryptonote::relative_output_offsets_to_absolute(
+                                in_key.key_offsets));
 
+                amounts_offsets[in_key.amount].insert(
+                        inputs_offsets.back().begin(),
+                        inputs_offsets.back().end());
+            }
 
-        map<string, vector<string>>
-        search_txs(vector<transaction> txs, const string& search_text)
-        {
-            map<string, vector<string>> tx_hashes;
+            // (amount, offset) -> mixin
+            map<pair<uint64_t, uint64_t>, ring_member> mixins;
 
-            // initlizte the map with empty results
-            tx_hashes["key_images"]                             = {};
-            tx_hashes["tx_public_keys"]                         = {};
-            tx_hashes["payments_id"]                            = {};
-            tx_hashes["encrypted_payments_id"]                  = {};
-            tx_hashes["output_public_keys"]                     = {};
+            // blocks and txs of the mixins
+            unordered_map<uint64_t, uint64_t> blk_timestamps;
+            unordered_map<crypto::hash, tx_summary> mixin_txs;
 
-            for (const transaction& tx: txs)
+            try
             {
+                for (const auto& amount_offsets: amounts_offsets)
+                {
+                    uint64_t amount = amount_offsets.first;
 
-                tx_details txd = get_tx_details(tx);
-
-                string tx_hash_str = pod_to_hex(txd.hash);
+                    vector<uint64_t> offsets(amount_offsets.second.begin(),
+                                             amount_offsets.second.end());
 
-                // check if any key_image matches the search_text
+                    vector<cryptonote::output_data_t> outputs;
+                    vector<tx_out_index> tx_out_indices;
 
-                vector<txin_to_key>::iterator it1 =
-                    find_if(begin(txd.input_key_imgs), end(txd.input_key_imgs),
-                        [&](const txin_to_key& key_img)
-                        {
-                            return pod_to_hex(key_img.k_image) == search_text;
-                        });
+                    db.get_output_key(amount, offsets, outputs);
+                    db.get_output_tx_and_index(amount, offsets, tx_out_indices);
 
-                if (it1 != txd.input_key_imgs.end())
-                {
-                    tx_hashes["key_images"].push_back(tx_hash_str);
-                }
+                    if (outputs.size() != offsets.size()
+                        || tx_out_indices.size() != offsets.size())
+                    {
+                        cerr << "Cant get all mixins of amount: " << amount << endl;
+                        return false;
+                    }
 
-                // check if  tx_public_key matches the search_text
+                    for (size_t i = 0; i < offsets.size(); ++i)
+                    {
+                        mixins[{amount, offsets[i]}]
+                                = ring_member {outputs[i], tx_out_indices[i], 0, {}};
 
-                if (pod_to_hex(txd.pk) == search_text)
-                {
-                    tx_hashes["tx_public_keys"].push_back(tx_hash_str);
+                        blk_timestamps[outputs[i].height] = 0;
+                        mixin_txs[tx_out_indices[i].first] = tx_summary {};
+                    }
                 }
 
-                // check if  payments_id matches the search_text
-
-                if (pod_to_hex(txd.payment_id) == search_text)
+                for (auto& blk_timestamp: blk_timestamps)
                 {
-                    tx_hashes["payment_id"].push_back(tx_hash_str);
+                    blk_timestamp.second = db.get_block_timestamp(blk_timestamp.first);
                 }
+            }
+            catch (const std::exception& e)
+            {
+                cerr << "Cant get mixins: " << e.what() << endl;
+                return false;
+            }
 
-                // check if  encrypted_payments_id matches the search_text
+            // get all not cached mixin txs at once
+            vector<crypto::hash> tx_hashes;
 
-                if (pod_to_hex(txd.payment_id8) == search_text)
+            for (auto& mixin_tx: mixin_txs)
+            {
+                if (!tx_summaries.get(mixin_tx.first, mixin_tx.second))
                 {
-                    tx_hashes["encrypted_payments_id"].push_back(tx_hash_str);
+                    tx_hashes.push_back(mixin_tx.first);
                 }
+            }
 
-                // check if output_public_keys matche the search_text
+            vector<transaction> txs;
+            vector<crypto::hash> missed_txs;
 
-                vector<pair<txout_to_key, uint64_t>>::iterator it2 =
-                    find_if(begin(txd.output_pub_keys), end(txd.output_pub_keys),
-                        [&](const pair<txout_to_key, uint64_t>& tx_out_pk)
-                        {
-                            return pod_to_hex(tx_out_pk.first.key) == search_text;
-                        });
+            if (!mcore->get_txs(tx_hashes, txs, missed_txs)
+                || !missed_txs.empty())
+            {
+                cerr << "Cant get " << missed_txs.size() << " mixin txs" << endl;
+                return false;
+            }
 
-                if (it2 != txd.output_pub_keys.end())
-                {
-                    tx_hashes["output_public_keys"].push_back(tx_hash_str);
-                }
+            // found txs are in the same order as tx_hashes
+            for (size_t i = 0; i < txs.size(); ++i)
+            {
+                tx_summary tx_sum = get_tx_summary(txs[i]);
 
+                mixin_txs[tx_hashes[i]] = tx_sum;
+
+                tx_summaries.put(tx_hashes[i], tx_sum);
             }
 
-            return  tx_hashes;
+            ring_members.clear();
+            ring_members.reserve(inputs.size());
+
+            for (size_t i = 0; i < inputs.size(); ++i)
+            {
+                ring_members.emplace_back();
 
+                for (uint64_t offset: inputs_offsets[i])
+                {
+                    ring_member mixin = mixins.at({inputs[i].amount, offset});
+
+                    mixin.blk_timestamp = blk_timestamps.at(mixin.output_data.height);
+                    mixin.tx_sum        = mixin_txs.at(mixin.tx_out_idx.first);
+
+                    ring_members.back().push_back(mixin);
+                }
+            }
+
+            return true;
         }
 
-        vector<transaction>
-        get_mempool_txs()
+        /**
+         * Only count inputs, outputs and mixins of a tx,
+         * without hashing it or parsing its extra.
+         */
+        tx_summary
+        get_tx_summary(const transaction& tx)
         {
-            // get mempool data using rpc call
-            vector<pair<tx_info, transaction>> mempool_data = search_mempool();
+            tx_summary tx_sum;
 
-            // output only transactions
-            vector<transaction> mempool_txs;
+            tx_sum.mixin_no = get_mixin_no(tx);
 
-            mempool_txs.reserve(mempool_data.size());
+            for (const txin_v& in: tx.vin)
+            {
+                if (in.type() == typeid(txin_to_key))
+                {
+                    ++tx_sum.no_inputs;
+                }
+            }
 
-            for (const auto& a_pair: mempool_data)
+            for (const tx_out& out: tx.vout)
             {
-                mempool_txs.push_back(a_pair.second);
+                if (out.target.type() == typeid(txout_to_key))
+                {
+                    ++tx_sum.no_outputs;
+                }
             }
 
-            return mempool_txs;
+            return tx_sum;
         }
 
-        string
-        show_search_results(const string& search_text,
-            const vector<pair<string, vector<string>>>& all_possible_tx_hashes)
+        /**
+         * Pages of blocks deep enough not to be reorganized
+         * can be cached.
+         */
+        bool
+        is_page_cacheable(uint64_t blk_height)
         {
+            return blk_height + MicroCore::CACHE_REORG_DEPTH
+                   < mcore->get_current_blockchain_height();
+        }
 
-            // initalise page tempate map with basic info about blockchain
-            mstch::map context {
-                    {"search_text"    , search_text},
-                    {"no_results"     , true},
-                    {"to_many_results", false}
-            };
+        /**
+         * Get cached page, with ages filled in, if
+         * there is one not older than RENDERED_PAGE_TTL.
+         */
+        bool
+        get_cached_page(const string& cache_key, time_t server_timestamp,
+                        string& html)
+        {
+            rendered_page cached;
 
-            for (const pair<string, vector<string>>& found_txs: all_possible_tx_hashes)
+            if (!rendered_pages.get(cache_key, cached))
             {
-                // define flag, e.g., has_key_images denoting that
-                // tx hashes for key_image searched were found
-                context.insert({"has_" + found_txs.first, !found_txs.second.empty()});
-
-                cout << "found_txs.first: " << found_txs.first << endl;
-
-                // insert new array based on what we found to context if not exist
-                pair< mstch::map::iterator, bool> res
-                        = context.insert({found_txs.first, mstch::array{}});
+                return false;
+            }
 
-                if (!found_txs.second.empty())
-                {
+            if (server_timestamp - cached.rendered_at > RENDERED_PAGE_TTL)
+            {
+                return false;
+            }
 
-                    uint64_t tx_i {0};
+            html = fill_ages(cached.html, server_timestamp);
 
-                    // for each found tx_hash, get the corresponding tx
-                    // and its details, and put into mstch for rendering
-                    for (const string& tx_hash: found_txs.second)
-                    {
+            return true;
+        }
 
-                        crypto::hash tx_hash_pod;
+        /**
+         * Markers of age, and age format, of a given timestamp.
+         * Used instead of get_age when rendering pages, so that
+         * the pages can be cached and the ages filled in later
+         * by fill_ages.
+         */
+        pair<string, string>
+        get_age_markers(uint64_t timestamp, bool full_format = 0)
+        {
+            string marker = fmt::format("{:d},{:d}", timestamp,
+                                        static_cast<int>(full_format))
+                            + AGE_MARKER_END;
 
-                        epee::string_tools::hex_to_pod(tx_hash, tx_hash_pod);
+            return {AGE_MARKER_BEGIN + string("a") + marker,
+                    AGE_MARKER_BEGIN + string("f") + marker};
+        }
 
-                        transaction tx;
+        /**
+         * Replace age markers in a rendered page with ages
+         * relative to server_timestamp.
+         */
+        string
+        fill_ages(const string& html, time_t server_timestamp)
+        {
+            string filled;
 
-                        uint64_t blk_height {0};
+            filled.reserve(html.size());
 
-                        int64_t blk_timestamp;
+            size_t pos {0};
 
-                        // first check in the blockchain
-                        if (mcore->get_tx(tx_hash, tx))
-                        {
+            while (pos < html.size())
+            {
+                size_t begin = html.find(AGE_MARKER_BEGIN, pos);
 
-                            // get timestamp of the tx's block
-                            blk_height    = core_storage
-                                    ->get_db().get_tx_block_height(tx_hash_pod);
+                size_t end = begin == string::npos
+                             ? string::npos
+                             : html.find(AGE_MARKER_END, begin);
 
-                            blk_timestamp = core_storage
-                                    ->get_db().get_block_timestamp(blk_height);
+                if (end == string::npos)
+                {
+                    filled.append(html, pos, string::npos);
+                    break;
+                }
 
-                        }
-                        else
-                        {
-                            // check in mempool if tx_hash not found in the
-                            // blockchain
-                            vector<pair<tx_info, transaction>> found_txs
-                                    = search_mempool(tx_hash_pod);
+                filled.append(html, pos, begin - pos);
 
-                            if (!found_txs.empty())
-                            {
-                                // there should be only one tx found
-                                tx = found_txs.at(0).second;
-                            }
-                            else
-                            {
-                                return string("Cant get tx of hash (show_search_results): " + tx_hash);
-                            }
+                // marker is: kind timestamp,full_format
+                char kind = html[begin + 1];
 
-                            // tx in mempool have no blk_timestamp
-                            // but can use their recive time
-                             blk_timestamp = found_txs.at(0).first.receive_time;
+                char* comma;
 
-                        }
+                uint64_t timestamp = std::strtoull(html.c_str() + begin + 2, &comma, 10);
 
-                        tx_details txd = get_tx_details(tx);
+                bool full_format = *(comma + 1) == '1';
 
-                        mstch::map txd_map = txd.get_mstch_map();
+                pair<string, string> age = get_age(server_timestamp, timestamp,
+                                                   full_format);
 
+                filled += (kind == 'a' ? age.first : age.second);
 
-                        // add the timestamp to tx mstch map
-                        txd_map.insert({"timestamp", xmreg::timestamp_to_str(blk_timestamp)});
+                pos = end + 1;
+            }
 
-                        boost::get<mstch::array>((res.first)->second).push_back(txd_map);
+            return filled;
+        }
 
-                        // dont show more than 500 results
-                        if (tx_i > 500)
-                        {
-                            context["to_many_results"] = true;
-                            break;
-                        }
+        /**
+         * Details of many txs. For a lot of txs, e.g., in big
+         * blocks, the details are obtained in parallel, on the
+         * threads of details_pool, shared by all requests.
+         */
+        vector<tx_details>
+        get_txs_details(const vector<transaction>& txs)
+        {
+            vector<tx_details> txs_details(txs.size());
 
-                        ++tx_i;
-                    }
+            size_t no_of_threads = std::min<size_t>(details_pool.size(),
+                                                    txs.size() / MIN_TXS_PER_THREAD);
 
-                    // if found something, set this flag to indicate this fact
-                    context["no_results"] = false;
+            if (no_of_threads < 2)
+            {
+                for (size_t i = 0; i < txs.size(); ++i)
+                {
+                    txs_details[i] = get_tx_details(txs[i]);
                 }
-            }
-
-            // read search_results.html
-            string search_results_html = xmreg::read(TMPL_SEARCH_RESULTS);
 
-            // add header and footer
-            string full_page = get_full_page(search_results_html);
+                return txs_details;
+            }
 
-            // read partial for showing details of tx(s) found
-            map<string, string> partials {
-                {"tx_table_head", xmreg::read(string(TMPL_PARIALS_DIR) + "/tx_table_header.html")},
-                {"tx_table_row" , xmreg::read(string(TMPL_PARIALS_DIR) + "/tx_table_row.html")}
-            };
+            // each thread gets every no_of_threads-th tx
+            vector<std::future<void>> workers;
 
-            // render the page
-            return  mstch::render(full_page, context, partials);
-        }
+            for (size_t t = 0; t < no_of_threads; ++t)
+            {
+                workers.push_back(details_pool.submit([&, t]()
+                {
+                    for (size_t i = t; i < txs.size(); i += no_of_threads)
+                    {
+                        txs_details[i] = get_tx_details(txs[i]);
+                    }
+                }));
+            }
 
+            // wait for all of them before get() can throw, as
+            // they use txs_details
+            for (std::future<void>& worker: workers)
+            {
+                worker.wait();
+            }
 
+            for (std::future<void>& worker: workers)
+            {
+                worker.get();
+            }
 
-    private:
+            return txs_details;
+        }
 
         tx_details
         get_tx_details(const transaction& tx, bool coinbase = false)
@@ -2015,74 +3972,23 @@ namespace xmreg {
         vector<pair<tx_info, transaction>>
         search_mempool(crypto::hash tx_hash = null_hash)
         {
+            // get current snapshot of txs in the mempool
+            shared_ptr<const mempool_snapshot> mempool = mempool_status.get_snapshot();
 
-            vector<pair<tx_info, transaction>> found_txs;
-
-            // get txs in the mempool
-            std::vector<tx_info> mempool_txs;
-
-            if (!rpc.get_mempool(mempool_txs))
+            // if we dont provide tx_hash, just get all txs in
+            // the mempool
+            if (tx_hash == null_hash)
             {
-              cerr << "Getting mempool failed " << endl;
-              return found_txs;
+                return mempool->txs;
             }
 
-            // if we have tx blob disply more.
-            // this info can also be obtained from json that is
-            // normally returned by the RCP call (see below in detailed view)
-            if (HAVE_TX_BLOB)
-            {
-                // get tx_blob if exists
-                //string tx_blob = get_tx_blob(_tx_info);
-
-                for (size_t i = 0; i < mempool_txs.size(); ++i)
-                {
-                    // get transaction info of the tx in the mempool
-                    tx_info _tx_info = mempool_txs.at(i);
-
-                    // get tx_blob if exists
-                    string tx_blob = get_tx_blob(_tx_info);
-
-                    if (tx_blob.empty())
-                    {
-                        cerr << "tx_blob is empty. Probably its not a custom deamon." << endl;
-                        continue;
-                    }
-
-                    // pare tx_blob into tx class
-                    transaction tx;
-
-                    if (!parse_and_validate_tx_from_blob(
-                            tx_blob, tx))
-                    {
-                        cerr << "Cant get tx from blob" << endl;
-                        continue;
-                    }
-
+            vector<pair<tx_info, transaction>> found_txs;
 
-                    // if we dont provide tx_hash, just get all txs in
-                    // the mempool
-                    if (tx_hash != null_hash)
-                    {
-                        // check if tx hash matches, and if yes, save it for return
-                        if (tx_hash == get_transaction_hash(tx))
-                        {
-                            found_txs.push_back(make_pair(_tx_info, tx));
-                            break;
-                        }
-                    }
-                    else
-                    {
-                       found_txs.push_back(make_pair(_tx_info, tx));
-                    }
+            auto it = mempool->tx_index.find(tx_hash);
 
-                }
-            }
-            else
+            if (it != mempool->tx_index.end())
             {
-                // @TODO make tx_info from json
-                // if dont have tx_blob member, construct tx_info
-                // from json obtained from the rpc call
+                found_txs.push_back(mempool->txs.at(it->second));
             }
 
             return found_txs;
@@ -2129,126 +4035,14 @@ namespace xmreg {
             return age_pair;
         }
 
-        pair<uint64_t, uint64_t>
-        sum_xmr_outputs(const string& json_str)
-        {
-            pair<uint64_t, uint64_t> sum_xmr {0, 0};
-
-            rapidjson::Document json;
-
-            if (json.Parse(json_str.c_str()).HasParseError())
-            {
-                cerr << "Failed to parse JSON" << endl;
-                return sum_xmr;
-            }
-
-            // get information about outputs
-            const rapidjson::Value& vout = json["vout"];
-
-            if (vout.IsArray())
-            {
-
-                for (rapidjson::SizeType i = 0; i < vout.Size(); ++i)
-                {
-                    //print(" - {:s}, {:0.8f} xmr\n",
-                    //    vout[i]["target"]["key"].GetString(),
-                    //    XMR_AMOUNT(vout[i]["amount"].GetUint64()));
-
-                    sum_xmr.first += vout[i]["amount"].GetUint64();
-                }
-
-                  sum_xmr.second = vout.Size();
-            }
-
-            return sum_xmr;
-        }
-
-        pair<uint64_t, uint64_t>
-        sum_xmr_inputs(const string& json_str)
-        {
-            pair<uint64_t, uint64_t> sum_xmr {0, 0};
-
-            rapidjson::Document json;
-
-            if (json.Parse(json_str.c_str()).HasParseError())
-            {
-                cerr << "Failed to parse JSON" << endl;
-                return sum_xmr;
-            }
-
-            // get information about inputs
-            const rapidjson::Value& vin = json["vin"];
-
-            if (vin.IsArray())
-            {
-                // print("Input key images:\n");
-
-                for (rapidjson::SizeType i = 0; i < vin.Size(); ++i)
-                {
-                    if (vin[i].HasMember("key"))
-                    {
-                        const rapidjson::Value& key_img = vin[i]["key"];
-
-                        // print(" - {:s}, {:0.8f} xmr\n",
-                        //       key_img["k_image"].GetString(),
-                        //       XMR_AMOUNT(key_img["amount"].GetUint64()));
-
-                        sum_xmr.first += key_img["amount"].GetUint64();
-                    }
-                }
-
-                sum_xmr.second = vin.Size();
-            }
-
-            return sum_xmr;
-        }
-
-
-        vector<uint64_t>
-        get_mixin_no_in_txs(const string& json_str)
-        {
-            vector<uint64_t> mixin_no;
-
-            rapidjson::Document json;
-
-            if (json.Parse(json_str.c_str()).HasParseError())
-            {
-                cerr << "Failed to parse JSON" << endl;
-                return mixin_no;
-            }
-
-            // get information about inputs
-            const rapidjson::Value& vin = json["vin"];
-
-            if (vin.IsArray())
-            {
-               // print("Input key images:\n");
-
-                for (rapidjson::SizeType i = 0; i < vin.Size(); ++i)
-                {
-                    if (vin[i].HasMember("key"))
-                    {
-                        const rapidjson::Value& key_img = vin[i]["key"];
-
-                        // print(" - {:s}, {:0.8f} xmr\n",
-                        //       key_img["k_image"].GetString(),
-                        //       XMR_AMOUNT(key_img["amount"].GetUint64()));
-
-
-                        mixin_no.push_back(key_img["key_offsets"].Size());
-                    }
-                }
-            }
-
-            return mixin_no;
-        }
-
-        string
-        get_full_page(string& middle)
+        /**
+         * Template with header and footer added. Full pages
+         * are made once, when the templates are loaded.
+         */
+        shared_ptr<const string>
+        get_full_page(const string& template_path)
         {
-            return xmreg::read(TMPL_HEADER)
-                   + middle
-                   + xmreg::read(TMPL_FOOTER);
+            return templates.get_full_page(template_path);
         }
 
     };
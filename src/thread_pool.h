@@ -0,0 +1,126 @@
+#ifndef XMREG01_THREAD_POOL_H
+#define XMREG01_THREAD_POOL_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+
+namespace xmreg
+{
+
+    using namespace std;
+
+    /**
+     * Fixed number of threads running submitted tasks in
+     * the order they were submitted. Threads are started once,
+     * and kept until the pool is destroyed, so that work split
+     * into many short tasks does not create threads for each.
+     */
+    class thread_pool
+    {
+        vector<std::thread> threads;
+
+        deque<std::packaged_task<void()>> tasks;
+
+        std::mutex              m_mutex;
+        std::condition_variable m_cv;
+        bool                    m_stop {false};
+
+    public:
+
+        explicit thread_pool(size_t no_of_threads)
+        {
+            if (no_of_threads == 0)
+            {
+                no_of_threads = 1;
+            }
+
+            for (size_t i = 0; i < no_of_threads; ++i)
+            {
+                threads.emplace_back(&thread_pool::work, this);
+            }
+        }
+
+        thread_pool(const thread_pool&) = delete;
+        thread_pool& operator=(const thread_pool&) = delete;
+
+        size_t
+        size() const
+        {
+            return threads.size();
+        }
+
+        /**
+         * Queue task to be run by the first free thread.
+         * The future is ready when the task is done.
+         */
+        std::future<void>
+        submit(std::function<void()> task)
+        {
+            std::packaged_task<void()> packaged {std::move(task)};
+
+            std::future<void> done = packaged.get_future();
+
+            {
+                std::lock_guard<std::mutex> lck (m_mutex);
+                tasks.push_back(std::move(packaged));
+            }
+
+            m_cv.notify_one();
+
+            return done;
+        }
+
+        /**
+         * Tasks already queued are run before the threads stop
+         */
+        ~thread_pool()
+        {
+            {
+                std::lock_guard<std::mutex> lck (m_mutex);
+                m_stop = true;
+            }
+
+            m_cv.notify_all();
+
+            for (std::thread& t: threads)
+            {
+                t.join();
+            }
+        }
+
+    private:
+
+        void
+        work()
+        {
+            while (true)
+            {
+                std::packaged_task<void()> task;
+
+                {
+                    std::unique_lock<std::mutex> lck (m_mutex);
+
+                    m_cv.wait(lck, [this]() { return m_stop || !tasks.empty(); });
+
+                    if (tasks.empty())
+                    {
+                        return;
+                    }
+
+                    task = std::move(tasks.front());
+                    tasks.pop_front();
+                }
+
+                task();
+            }
+        }
+    };
+
+}
+
+#endif //XMREG01_THREAD_POOL_H
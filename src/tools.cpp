@@ -4,6 +4,8 @@
 
 #include "tools.h"
 
+#include "rapidjson/reader.h"
+
 
 
 namespace xmreg
@@ -614,6 +616,167 @@ namespace xmreg
         return make_pair(empty_time, scale);
     }
 
+    /**
+     * rapidjson SAX handler that sums inputs and outputs of
+     * tx json, and counts their key offsets, without building
+     * the json document. The tx json looks like:
+     *
+     * {"vin": [{"key": {"amount": 1, "key_offsets": [1, 2], ...}}, ...],
+     *  "vout": [{"amount": 1, "target": {...}}, ...], ...}
+     */
+    class tx_json_summarizer
+        : public rapidjson::BaseReaderHandler<rapidjson::UTF8<>, tx_json_summarizer>
+    {
+        mempool_tx_summary& summary;
+
+        // current nesting of objects and arrays. The root object is 1.
+        size_t depth {0};
+
+        // last key seen at each depth of objects
+        vector<string> keys;
+
+        bool
+        in_vin_key(size_t key_depth) const
+        {
+            return depth >= key_depth && keys[1] == "vin" && keys[3] == "key";
+        }
+
+    public:
+
+        tx_json_summarizer(mempool_tx_summary& _summary)
+            : summary {_summary}, keys(8)
+        {}
+
+        bool
+        StartObject()
+        {
+            start();
+
+            // each element of vin and vout is an object
+            if (depth == 3 && keys[1] == "vin")
+            {
+                ++summary.no_inputs;
+            }
+            else if (depth == 3 && keys[1] == "vout")
+            {
+                ++summary.no_outputs;
+            }
+
+            return true;
+        }
+
+        bool
+        StartArray()
+        {
+            start();
+
+            if (depth == 5 && in_vin_key(5) && keys[4] == "key_offsets")
+            {
+                summary.mixin_no.push_back(0);
+            }
+
+            return true;
+        }
+
+        bool
+        Key(const char* str, rapidjson::SizeType length, bool)
+        {
+            if (depth < keys.size())
+            {
+                keys[depth].assign(str, length);
+            }
+
+            return true;
+        }
+
+        bool
+        EndObject(rapidjson::SizeType)
+        {
+            --depth;
+            return true;
+        }
+
+        bool
+        EndArray(rapidjson::SizeType)
+        {
+            --depth;
+            return true;
+        }
+
+        bool Uint(unsigned u)  { return number(u); }
+        bool Uint64(uint64_t u) { return number(u); }
+
+        bool
+        Default()
+        {
+            count_key_offset();
+            return true;
+        }
+
+    private:
+
+        void
+        start()
+        {
+            ++depth;
+
+            if (depth < keys.size())
+            {
+                keys[depth].clear();
+            }
+        }
+
+        bool
+        number(uint64_t value)
+        {
+            if (depth == 4 && in_vin_key(4) && keys[4] == "amount")
+            {
+                summary.sum_inputs += value;
+            }
+            else if (depth == 3 && keys[1] == "vout" && keys[3] == "amount")
+            {
+                summary.sum_outputs += value;
+            }
+
+            count_key_offset();
+
+            return true;
+        }
+
+        void
+        count_key_offset()
+        {
+            if (depth == 5 && in_vin_key(5) && keys[4] == "key_offsets")
+            {
+                ++summary.mixin_no.back();
+            }
+        }
+    };
+
+
+    /**
+     * Sum inputs and outputs of a tx given as json, and
+     * get ring sizes of its inputs, in a single pass over the json.
+     */
+    bool
+    summarize_tx_json(const string& json_str, mempool_tx_summary& summary)
+    {
+        summary = mempool_tx_summary {};
+
+        tx_json_summarizer handler {summary};
+
+        rapidjson::Reader reader;
+        rapidjson::StringStream json_stream {json_str.c_str()};
+
+        if (reader.Parse(json_stream, handler).IsError())
+        {
+            cerr << "Failed to parse JSON" << endl;
+            return false;
+        }
+
+        return true;
+    }
+
     time_t
     to_time_t(pt::ptime t)
     {
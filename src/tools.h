@@ -152,6 +152,24 @@ namespace xmreg
     vector<uint64_t>
     get_mixin_no_in_txs(const vector<transaction>& txs);
 
+    /**
+     * What is shown about a tx in the mempool, obtained
+     * from its json returned by the deamon
+     */
+    struct mempool_tx_summary
+    {
+        uint64_t sum_inputs  {0};
+        uint64_t no_inputs   {0};
+        uint64_t sum_outputs {0};
+        uint64_t no_outputs  {0};
+
+        // ring size of each key input
+        vector<uint64_t> mixin_no;
+    };
+
+    bool
+    summarize_tx_json(const string& json_str, mempool_tx_summary& summary);
+
     vector<pair<txout_to_key, uint64_t>>
     get_ouputs(const transaction& tx);
 